@@ -5,4 +5,14 @@
 
 enum {SEEK_SET, SEEK_CUR, SEEK_END};
 
+#define NR_FD 32
+
+/* An open file of a process. Each open has its own offset. */
+typedef struct {
+  int file;       // index in the file table, or -1 if the fd is free
+  off_t offset;
+} Fd;
+
+void init_fd_table(Fd *fd_table);
+
 #endif
@@ -13,6 +13,9 @@
 #define PGROUNDUP(sz)   (((sz)+PGSIZE-1) & ~PGMASK)
 #define PGROUNDDOWN(a)  (((a)) & ~PGMASK)
 
+/* Where mmap() places file extents in a process */
+#define MMAP_START 0x40000000
+
 void* new_page(void);
 
 #endif
@@ -3,17 +3,52 @@
 
 #include "common.h"
 #include "memory.h"
+#include "fs.h"
 
 #define STACK_SIZE (8 * PGSIZE)
+#define MAX_NR_SEG 4
+
+enum {PROC_UNUSED, PROC_READY, PROC_SLEEP, PROC_STOP, PROC_EXIT};
+
+#define HZ 100  // timer ticks per second
+
+/* At a tick, a ready process of a higher priority preempts the running
+ * one. Processes of the same priority take turns, each running for its
+ * time slice in timer ticks. */
+#define PRIO_GAME 2
+#define PRIO_BACKGROUND 1
+
+#define SLICE_GAME 10
+#define SLICE_BACKGROUND 1
+
+/* A loadable segment of a program, whose pages are loaded on demand */
+typedef struct {
+  uintptr_t vaddr, memsz, filesz;
+  off_t disk_offset;    // where the data of the segment is in the ramdisk
+} Segment;
 
 typedef union {
   uint8_t stack[STACK_SIZE] PG_ALIGN;
   struct {
+    int pid;
+    int state;
+    int priority;
+    int timeslice;      // timer ticks in a time slice
+    int slice;          // timer ticks left in the time slice
+    bool woken;         // woken since it went to sleep last time
+    uint32_t ticks;     // timer ticks it has run for
+    uint32_t nr_switch; // times it is switched to
+    char name[32];
     _RegSet *tf;
     _Protect as;
     uintptr_t cur_brk;
-    // we do not free memory, so use `max_brk' to determine when to call _map()
+    // the heap never shrinks, so use `max_brk' to determine when to call _map()
     uintptr_t max_brk;
+    // the end of the mmap() area, which grows from MMAP_START
+    uintptr_t mmap_brk;
+    Fd fd_table[NR_FD];
+    int nr_seg;
+    Segment seg[MAX_NR_SEG];
   };
 } PCB;
 
@@ -9,12 +9,44 @@ static const char *keyname[256] __attribute__((used)) = {
 };
 
 void switch_game();
+void proc_wakeup();
+bool proc_sleep();
+
+// keys received by the keyboard interrupt; the handler only moves the tail
+// and events_read() only moves the head, so no lock is needed
+#define NR_KEY_BUF 64
+static int key_buf[NR_KEY_BUF];
+static volatile int key_head = 0, key_tail = 0;
+
+void keyboard_intr() {
+  int key;
+  while ((key = _read_key()) != _KEY_NONE) {
+    int next = (key_tail + 1) % NR_KEY_BUF;
+    if (next == key_head) break;  // full, later keys are left in the device
+    key_buf[key_tail] = key;
+    key_tail = next;
+  }
+  proc_wakeup();
+}
+
+static int read_key() {
+  if (key_head == key_tail) {
+    // the device is still polled in case the interrupt is masked
+    return _read_key();
+  }
+  int key = key_buf[key_head];
+  key_head = (key_head + 1) % NR_KEY_BUF;
+  return key;
+}
 
 size_t events_read(void *buf, size_t len) {
-  int key = _read_key();
+  int key = read_key();
   bool down = false;
-  if (key == _KEY_NONE)
+  if (key == _KEY_NONE) {
+    // wait for a key until the next tick instead of polling
+    if (proc_sleep()) return 0;
     sprintf((char *)buf, "t %u\n", _uptime());
+  }
   else {
     if (key & 0x8000) {
       key ^= 0x8000;
@@ -1,13 +1,15 @@
 #include "fs.h"
+#include "proc.h"
 
 typedef struct {
   char *name;
   size_t size;
   off_t disk_offset;
-  off_t open_offset;
 } Finfo;
 
-enum {FD_STDIN, FD_STDOUT, FD_STDERR, FD_FB, FD_EVENTS, FD_DISPINFO, FD_NORMAL};
+/* Indices in file_table. A new fd table opens the first three of them
+ * as fd 0, 1 and 2. */
+enum {FD_STDIN, FD_STDOUT, FD_STDERR, FD_FB, FD_EVENTS, FD_DISPINFO, FD_MEMINFO, FD_PROCINFO, FD_NORMAL};
 
 /* This is the information about all files in disk. */
 static Finfo file_table[] __attribute__((used)) = {
@@ -17,6 +19,8 @@ static Finfo file_table[] __attribute__((used)) = {
   [FD_FB] = {"/dev/fb", 0, 0},
   [FD_EVENTS] = {"/dev/events", 0, 0},
   [FD_DISPINFO] = {"/proc/dispinfo", 128, 0},
+  [FD_MEMINFO] = {"/proc/meminfo", 128, 0},
+  [FD_PROCINFO] = {"/proc/procinfo", 512, 0},
 #include "files.h"
 };
 
@@ -24,62 +28,134 @@ static Finfo file_table[] __attribute__((used)) = {
 
 void ramdisk_read(void *buf, off_t offset, size_t len);
 void ramdisk_write(const void *buf, off_t offset, size_t len);
+void* ramdisk_addr(off_t offset, size_t len);
 void dispinfo_read(void *buf, off_t offset, size_t len);
+void meminfo_read(void *buf, off_t offset, size_t len);
+void procinfo_read(void *buf, off_t offset, size_t len);
 void fb_write(const void *buf, off_t offset, size_t len);
 size_t events_read(void *buf, size_t len);
 
+/* Open addressing index from the hash of a path to its file, so that
+ * fs_open() does not scan file_table. A slot holds the index plus 1. */
+#define NR_NAME_SLOT 1024
+static uint16_t name_index[NR_NAME_SLOT];
+
+static uint32_t name_hash(const char *name) {
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (; *name; name ++) {
+    h = (h ^ (uint8_t)*name) * 16777619u;
+  }
+  return h;
+}
+
+static int file_lookup(const char *name) {
+  uint32_t i = name_hash(name);
+  for (; name_index[i % NR_NAME_SLOT] != 0; i ++) {
+    int file = name_index[i % NR_NAME_SLOT] - 1;
+    if (strcmp(file_table[file].name, name) == 0) return file;
+  }
+  return -1;
+}
+
+/* The fds of the kernel, e.g. the loader, before any process runs */
+static Fd kernel_fd_table[NR_FD];
+
+static inline Fd* fd_table() {
+  return (current ? current->fd_table : kernel_fd_table);
+}
+
+static inline Fd* get_fd(int fd) {
+  assert(fd >= 0 && fd < NR_FD);
+  Fd *f = &fd_table()[fd];
+  assert(f->file != -1);
+  return f;
+}
+
+void init_fd_table(Fd *fd_table) {
+  int fd;
+  for (fd = 0; fd < NR_FD; fd ++) {
+    fd_table[fd].file = (fd <= FD_STDERR ? fd : -1);
+    fd_table[fd].offset = 0;
+  }
+}
+
 void init_fs() {
   // initialize the size of /dev/fb
   file_table[FD_FB].size = _screen.width * _screen.height * sizeof(uint32_t);
+
+  assert(NR_FILES * 2 <= NR_NAME_SLOT);
+  int file;
+  for (file = 0; file < NR_FILES; file ++) {
+    uint32_t i = name_hash(file_table[file].name);
+    while (name_index[i % NR_NAME_SLOT] != 0) i ++;
+    name_index[i % NR_NAME_SLOT] = file + 1;
+  }
+
+  init_fd_table(kernel_fd_table);
 }
 
 int fs_open(const char *pathname, int flags, int mode) {
+  int file = file_lookup(pathname);
+  if (file == -1) {
+    Log("file %s not found", pathname);
+    return -1;
+  }
+
+  Fd *fds = fd_table();
   int fd;
-  for (fd = 0; fd < NR_FILES; ++fd) 
-    if (strcmp(file_table[fd].name, pathname) == 0) {
-      file_table[fd].open_offset = 0;
+  for (fd = 0; fd < NR_FD; fd ++) {
+    if (fds[fd].file == -1) {
+      fds[fd].file = file;
+      fds[fd].offset = 0;
       return fd;
     }
-  assert(0);
+  }
+  Log("no free fd for %s", pathname);
   return -1;
 }
 
 ssize_t fs_read(int fd, void *buf, size_t len) {
-  assert(fd != FD_STDOUT && fd != FD_STDERR && fd != FD_STDIN);   // cases to ignore
-  assert(fd < NR_FILES);
+  Fd *f = get_fd(fd);
+  int file = f->file;
+  assert(file != FD_STDOUT && file != FD_STDERR && file != FD_STDIN);   // cases to ignore
   
-  off_t fd_open_offset, offset;
+  off_t offset;
   size_t fd_size;
 
-  if (fd == FD_EVENTS) 
+  if (file == FD_EVENTS) 
     return events_read(buf, len);
   
-  fd_open_offset = file_table[fd].open_offset;
-  fd_size = file_table[fd].size;
+  fd_size = file_table[file].size;
   
-  if (fd_open_offset >= fd_size)
+  if (f->offset >= fd_size)
     return 0;
-  if (fd_open_offset + len > fd_size)
-    len = fd_size - fd_open_offset;
-  offset = file_table[fd].disk_offset + fd_open_offset;
+  if (f->offset + len > fd_size)
+    len = fd_size - f->offset;
+  offset = file_table[file].disk_offset + f->offset;
   
-  if (fd == FD_DISPINFO)
+  if (file == FD_DISPINFO)
     dispinfo_read(buf, offset, len);
+  else if (file == FD_MEMINFO)
+    meminfo_read(buf, offset, len);
+  else if (file == FD_PROCINFO)
+    procinfo_read(buf, offset, len);
   else
     ramdisk_read(buf, offset, len);
     
-  file_table[fd].open_offset += len;
+  f->offset += len;
   return len;
 }
 
 ssize_t fs_write(int fd, const void *buf, size_t len) {
-  assert(fd != FD_STDIN);
-  assert(fd < NR_FILES);
+  Fd *f = get_fd(fd);
+  int file = f->file;
+  assert(file != FD_STDIN);
   
   int i;
-  off_t fd_open_offset, offset;
+  off_t offset;
   size_t fd_size;
-  switch (fd) {
+  switch (file) {
     case FD_STDOUT:
     case FD_STDERR:
       for (i = 0; i < len; ++i)
@@ -87,39 +163,51 @@ ssize_t fs_write(int fd, const void *buf, size_t len) {
       return i;
       
     default:
-      fd_open_offset = file_table[fd].open_offset;
-      fd_size = file_table[fd].size;
+      fd_size = file_table[file].size;
   
-      if (fd_open_offset >= fd_size)
+      if (f->offset >= fd_size)
         return 0;
-      if (fd_open_offset + len > fd_size)
-        len = fd_size - fd_open_offset;
-      offset = file_table[fd].disk_offset + fd_open_offset;
-      if (fd == FD_FB) 
+      if (f->offset + len > fd_size)
+        len = fd_size - f->offset;
+      offset = file_table[file].disk_offset + f->offset;
+      if (file == FD_FB) 
         fb_write(buf, offset, len);
       else
         ramdisk_write(buf, offset, len);
-      file_table[fd].open_offset += len;
+      f->offset += len;
       return len;
   }  
 }
 
 off_t fs_lseek(int fd, off_t offset, int whence) {
-  assert(fd < NR_FILES);
+  Fd *f = get_fd(fd);
   switch (whence) {
-    case SEEK_SET: file_table[fd].open_offset = offset; break;
-    case SEEK_CUR: file_table[fd].open_offset += offset; break;
-    case SEEK_END: file_table[fd].open_offset = file_table[fd].size + offset; break;
+    case SEEK_SET: f->offset = offset; break;
+    case SEEK_CUR: f->offset += offset; break;
+    case SEEK_END: f->offset = file_table[f->file].size + offset; break;
     default: return -1;
   }
-  return file_table[fd].open_offset;
+  return f->offset;
 }
 
 int fs_close(int fd) {
+  get_fd(fd)->file = -1;
   return 0;
 }
 
 size_t fs_filesz(int fd) {
-  return file_table[fd].size;
+  return file_table[get_fd(fd)->file].size;
 }
 
+off_t fs_disk_offset(int fd) {
+  return file_table[get_fd(fd)->file].disk_offset;
+}
+
+/* Return where `len' bytes from `offset' of a regular file are in the
+ * ramdisk, or NULL if they are out of the file. */
+void* fs_mmap(int fd, off_t offset, size_t len) {
+  Fd *f = get_fd(fd);
+  if (f->file < FD_NORMAL || offset < 0 || offset + len > file_table[f->file].size)
+    return NULL;
+  return ramdisk_addr(file_table[f->file].disk_offset + offset, len);
+}
@@ -1,13 +1,18 @@
-#include "common.h"
+#include "proc.h"
 
 _RegSet* do_syscall(_RegSet *r);
 _RegSet* schedule(_RegSet *prev);
+_RegSet* proc_tick(_RegSet *prev);
+void keyboard_intr();
+void mm_page_fault(uintptr_t va);
 
 static _RegSet* do_event(_Event e, _RegSet* r) {
   switch (e.event) {
     case _EVENT_SYSCALL: return do_syscall(r);
     case _EVENT_TRAP: return schedule(r);
-    case _EVENT_IRQ_TIME: return schedule(r);
+    case _EVENT_IRQ_TIME: return proc_tick(r);
+    case _EVENT_IRQ_IODEV: keyboard_intr(); return r;
+    case _EVENT_PAGE_FAULT: mm_page_fault(e.cause); return r;
     default: panic("Unhandled event ID = %d", e.event);
   }
 
@@ -16,4 +21,5 @@ static _RegSet* do_event(_Event e, _RegSet* r) {
 
 void init_irq(void) {
   _asye_init(do_event);
+  _timer_period(1000000 / HZ);
 }
@@ -1,27 +1,45 @@
-#include "common.h"
-
-#define DEFAULT_ENTRY ((void *)0x8048000)
-
-void* new_page(void);
+#include "proc.h"
+#include <elf.h>
 
 int fs_open(const char *pathname, int flags, int mode);
-size_t fs_filesz(int fd);
 ssize_t fs_read(int fd, void *buf, size_t len);
+off_t fs_lseek(int fd, off_t offset, int whence);
+off_t fs_disk_offset(int fd);
 int fs_close(int fd);
 
-uintptr_t loader(_Protect *as, const char *filename) {
+/* Record the PT_LOAD segments of the ELF file `filename' in `pcb'.
+ * Nothing is loaded here: the pages of a segment are loaded when
+ * the program touches them for the first time. */
+uintptr_t loader(PCB *pcb, const char *filename) {
   int fd = fs_open(filename, 0, 0);
-  int i, pages = fs_filesz(fd) / PGSIZE + 1;
-  void *pa, *va;
-  
-  for (i = 0, va = DEFAULT_ENTRY; i < pages; ++i, va += PGSIZE) {
-    pa = new_page();
-    // printf("pa: %x, va: %x", pa, va);
-    // printf(", read: %d\n", fs_read(fd, pa, PGSIZE));
-    fs_read(fd, pa, PGSIZE);
-    _map(as, va, pa);
+  assert(fd != -1);
+
+  Elf32_Ehdr elf;
+  assert(fs_read(fd, &elf, sizeof(elf)) == sizeof(elf));
+  assert(*(uint32_t *)elf.e_ident == 0x464c457f);   // "\x7fELF"
+
+  int i;
+  pcb->nr_seg = 0;
+  pcb->cur_brk = pcb->max_brk = 0;
+  for (i = 0; i < elf.e_phnum; i ++) {
+    Elf32_Phdr ph;
+    fs_lseek(fd, elf.e_phoff + i * elf.e_phentsize, SEEK_SET);
+    assert(fs_read(fd, &ph, sizeof(ph)) == sizeof(ph));
+    if (ph.p_type != PT_LOAD || ph.p_memsz == 0) continue;
+
+    assert(pcb->nr_seg < MAX_NR_SEG && ph.p_filesz <= ph.p_memsz);
+    Segment *s = &pcb->seg[pcb->nr_seg ++];
+    s->vaddr = ph.p_vaddr;
+    s->memsz = ph.p_memsz;
+    s->filesz = ph.p_filesz;
+    s->disk_offset = fs_disk_offset(fd) + ph.p_offset;
+
+    // the heap starts after the last segment
+    if (s->vaddr + s->memsz > pcb->max_brk) {
+      pcb->cur_brk = pcb->max_brk = s->vaddr + s->memsz;
+    }
   }
 
   fs_close(fd);
-  return (uintptr_t)DEFAULT_ENTRY;
+  return elf.e_entry;
 }
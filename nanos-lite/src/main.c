@@ -1,4 +1,4 @@
-#include "common.h"
+#include "proc.h"
 
 /* Uncomment these macros to enable corresponding functionality. */
 #define HAS_ASYE
@@ -9,8 +9,7 @@ void init_ramdisk(void);
 void init_device(void);
 void init_irq(void);
 void init_fs(void);
-uint32_t loader(_Protect *, const char *);
-void load_prog(const char *filename);
+void load_prog(const char *filename, int priority, int timeslice);
 
 int main() {
 #ifdef HAS_PTE
@@ -31,9 +30,9 @@ int main() {
 
   init_fs();
 
-  load_prog("/bin/pal");
-  load_prog("/bin/hello");
-  load_prog("/bin/videotest");
+  load_prog("/bin/pal", PRIO_GAME, SLICE_GAME);
+  load_prog("/bin/hello", PRIO_BACKGROUND, SLICE_BACKGROUND);
+  load_prog("/bin/videotest", PRIO_GAME, SLICE_GAME);
   
   _trap();
   
@@ -1,17 +1,64 @@
 #include "proc.h"
 #include "memory.h"
 
-static void *pf = NULL;
+/* Physical pages are allocated one at a time, which is all the kernel
+ * and AM ask for. Freed pages are linked through their first word and
+ * reused first. A page mapped into a process records the process, so
+ * that it is freed with the process. */
+static void *frame_base = NULL;   // the first page managed
+static void *pf = NULL;           // pages from here have never been used
+static void *free_list = NULL;
+static uint8_t *frame_owner;      // pid + 1 of the process owning each page, or 0
+static uint32_t nr_frame = 0, nr_alloc = 0, nr_free = 0;
+
+#define FRAME_NO(p) (((uintptr_t)(p) - (uintptr_t)frame_base) / PGSIZE)
 
 void* new_page(void) {
-  assert(pf < (void *)_heap.end);
-  void *p = pf;
-  pf += PGSIZE;
+  void *p;
+  if (free_list != NULL) {
+    p = free_list;
+    free_list = *(void **)p;
+  }
+  else {
+    assert(pf < (void *)_heap.end);
+    p = pf;
+    pf += PGSIZE;
+  }
+  nr_alloc ++;
   return p;
 }
 
 void free_page(void *p) {
-  panic("not implement yet");
+  assert(p >= frame_base && p < pf && ((uintptr_t)p & PGMASK) == 0);
+  frame_owner[FRAME_NO(p)] = 0;
+  *(void **)p = free_list;
+  free_list = p;
+  nr_free ++;
+}
+
+/* a page to be mapped into the current process */
+static void* new_user_page(void) {
+  void *p = new_page();
+  frame_owner[FRAME_NO(p)] = current->pid + 1;
+  return p;
+}
+
+/* Free the pages mapped into `pcb', whose address space should
+ * not be in use. */
+void mm_free_pages(PCB *pcb) {
+  uint32_t i, n = FRAME_NO(pf);
+  for (i = 0; i < n; i ++) {
+    if (frame_owner[i] == pcb->pid + 1) {
+      free_page(frame_base + i * PGSIZE);
+    }
+  }
+}
+
+void meminfo_read(void *buf, off_t offset, size_t len) {
+  static char meminfo[128];
+  snprintf(meminfo, sizeof(meminfo), "PAGES:%d\nUSED:%d\nALLOC:%d\nFREE:%d\n",
+      nr_frame, nr_alloc - nr_free, nr_alloc, nr_free);
+  memcpy(buf, meminfo + offset, len);
 }
 
 /* The brk() system call handler. */
@@ -25,7 +72,7 @@ int mm_brk(uint32_t new_brk) {
       void *va_end = (void *)((new_brk - 1) & ~0xfff);
       void *va;
       for (va = va_begin; va <= va_end; va += PGSIZE)
-        _map(&current->as, va, new_page());
+        _map(&current->as, va, new_user_page());
       current->max_brk = new_brk;
     }
     current->cur_brk = new_brk;
@@ -33,8 +80,80 @@ int mm_brk(uint32_t new_brk) {
   return 0;
 }
 
+void ramdisk_read(void *buf, off_t offset, size_t len);
+
+/* Load the page at `va' of the current process when it is touched for
+ * the first time. Every segment overlapping the page provides its part
+ * of the file, and the rest of the page is zero. */
+void mm_page_fault(uintptr_t va) {
+  uintptr_t page = PGROUNDDOWN(va);
+  void *pa = NULL;
+  int i;
+  for (i = 0; i < current->nr_seg; i ++) {
+    Segment *s = &current->seg[i];
+    if (page + PGSIZE <= s->vaddr || page >= s->vaddr + s->memsz) continue;
+
+    if (pa == NULL) {
+      pa = new_user_page();
+      memset(pa, 0, PGSIZE);
+    }
+    uintptr_t lo = (page > s->vaddr ? page : s->vaddr);
+    uintptr_t hi = (page + PGSIZE < s->vaddr + s->filesz ? page + PGSIZE : s->vaddr + s->filesz);
+    if (lo < hi) {
+      ramdisk_read(pa + (lo - page), s->disk_offset + (lo - s->vaddr), hi - lo);
+    }
+  }
+
+  if (pa == NULL) {
+    panic("page fault at address 0x%x out of the program", va);
+  }
+  _map(&current->as, (void *)page, pa);
+}
+
+void* fs_mmap(int fd, off_t offset, size_t len);
+
+/* The mmap() system call handler. The ramdisk pages holding the file
+ * extent are mapped after the previous mappings, so the process reads
+ * the file with no copies. The pages are not write-protected, and the
+ * bytes of other files sharing the first or last page can be seen. */
+uintptr_t mm_mmap(int fd, off_t offset, size_t len) {
+  void *start = fs_mmap(fd, offset, len);
+  if (start == NULL || len == 0)
+    return -1;
+
+  // physical memory is identically mapped in the kernel
+  uintptr_t pa = PGROUNDDOWN((uintptr_t)start);
+  uintptr_t pa_end = PGROUNDUP((uintptr_t)start + len);
+  uintptr_t va = current->mmap_brk;
+  if (pa_end - pa > (uintptr_t)current->as.area.end - va)
+    return -1;
+  for (; pa < pa_end; pa += PGSIZE) {
+    _map(&current->as, (void *)current->mmap_brk, (void *)pa);
+    current->mmap_brk += PGSIZE;
+  }
+  return va + ((uintptr_t)start & PGMASK);
+}
+
+/* The munmap() system call handler. Only the mmap() area is unmapped,
+ * and its pages are in the ramdisk, so none of them is freed. */
+int mm_munmap(uintptr_t addr, size_t len) {
+  uintptr_t va = PGROUNDDOWN(addr), va_end = PGROUNDUP(addr + len);
+  if (va < MMAP_START || va_end > current->mmap_brk || va_end < va)
+    return -1;
+  for (; va < va_end; va += PGSIZE) {
+    _unmap(&current->as, (void *)va);
+  }
+  return 0;
+}
+
 void init_mm() {
-  pf = (void *)PGROUNDUP((uintptr_t)_heap.start);
+  frame_base = (void *)PGROUNDUP((uintptr_t)_heap.start);
+  nr_frame = ((uintptr_t)_heap.end - (uintptr_t)frame_base) / PGSIZE;
+
+  // the owners of pages are kept in the first pages
+  frame_owner = frame_base;
+  memset(frame_owner, 0, nr_frame);
+  pf = frame_base + PGROUNDUP(nr_frame);
   Log("free physical pages starting from %p", pf);
 
   _pte_init(new_page, free_page);
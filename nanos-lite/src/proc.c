@@ -6,14 +6,33 @@ static PCB pcb[MAX_NR_PROC];
 static int nr_proc = 0;
 PCB *current = NULL;
 PCB *current_game = &pcb[0];
+static uint32_t idle_ticks = 0;
 
-uintptr_t loader(_Protect *as, const char *filename);
+uintptr_t loader(PCB *pcb, const char *filename);
+void mm_free_pages(PCB *pcb);
 
-void load_prog(const char *filename) {
+int fs_open(const char *pathname, int flags, int mode);
+int fs_close(int fd);
+
+static void set_name(PCB *p, const char *filename) {
+  strncpy(p->name, filename, sizeof(p->name) - 1);
+  p->name[sizeof(p->name) - 1] = '\0';
+}
+
+void load_prog(const char *filename, int priority, int timeslice) {
+  assert(nr_proc < MAX_NR_PROC && timeslice > 0);
   int i = nr_proc ++;
+  pcb[i].pid = i;
+  pcb[i].priority = priority;
+  pcb[i].timeslice = timeslice;
+  // only the game in the foreground runs
+  pcb[i].state = (priority == PRIO_GAME && &pcb[i] != current_game ? PROC_STOP : PROC_READY);
+  set_name(&pcb[i], filename);
   _protect(&pcb[i].as);
+  init_fd_table(pcb[i].fd_table);
+  pcb[i].mmap_brk = MMAP_START;
 
-  uintptr_t entry = loader(&pcb[i].as, filename);
+  uintptr_t entry = loader(&pcb[i], filename);
 
   // TODO: remove the following three lines after you have implemented _umake()
   // _switch(&pcb[i].as);
@@ -27,24 +46,169 @@ void load_prog(const char *filename) {
   pcb[i].tf = _umake(&pcb[i].as, stack, stack, (void *)entry, NULL, NULL);
 }
 
+/* Replace the program of the current process with `filename', and free
+ * the memory of the old one. Return the context to run the new program,
+ * or NULL if the file does not exist. */
+_RegSet* proc_execve(const char *filename) {
+  // the name is in the old program
+  char path[128];
+  if (strlen(filename) >= sizeof(path)) return NULL;
+  strcpy(path, filename);
+
+  int fd = fs_open(path, 0, 0);
+  if (fd == -1) return NULL;
+  fs_close(fd);
+
+  PCB *p = current;
+  _Protect old_as = p->as;
+  _protect(&p->as);
+  _switch(&p->as);
+  mm_free_pages(p);
+  _release(&old_as);
+
+  p->mmap_brk = MMAP_START;
+  set_name(p, path);
+  uintptr_t entry = loader(p, path);
+
+  // The context is made at the top of the stack, which is only used by
+  // the frames of the old program, since the kernel runs below them.
+  _Area stack;
+  stack.start = p->stack;
+  stack.end = stack.start + sizeof(p->stack);
+  p->tf = _umake(&p->as, stack, stack, (void *)entry, NULL, NULL);
+  return p->tf;
+}
+
 void switch_game() {
-  current_game = (current_game == &pcb[0] ? &pcb[2] : &pcb[0]);
+  PCB *next = (current_game == &pcb[0] ? &pcb[2] : &pcb[0]);
+  if (next->state != PROC_STOP) return;
+  if (current_game->state != PROC_EXIT)
+    current_game->state = PROC_STOP;
+  next->state = PROC_READY;
+  current_game = next;
+}
+
+/* Pick the process to run after `current' in turn. If no process is
+ * ready, a sleeping one is picked, which waits in its system call. */
+static PCB* pick_next(void) {
+  int start = (current == NULL ? nr_proc - 1 : current - pcb);
+  int k;
+  for (k = 1; k <= nr_proc; k ++) {
+    PCB *p = &pcb[(start + k) % nr_proc];
+    if (p->state == PROC_READY) return p;
+  }
+  for (k = 1; k <= nr_proc; k ++) {
+    PCB *p = &pcb[(start + k) % nr_proc];
+    if (p->state == PROC_SLEEP) return p;
+  }
+  return NULL;
+}
+
+static _RegSet* switch_to(PCB *next) {
+  if (next != current) {
+    next->nr_switch ++;
+    _switch(&next->as);
+    current = next;
+  }
+  current->slice = current->timeslice;
+  return current->tf;
 }
 
 _RegSet* schedule(_RegSet *prev) {
-  // printf("Hello from schedule\n");
   if (current)
     current->tf = prev;
-  static int count_game = 0;
-  // time for game and hello is 100 : 1 
-  if (count_game >= 100 && current != &pcb[1]) {
-    current = &pcb[1];
-    count_game = 0;
+  PCB *next = pick_next();
+  assert(next != NULL);
+  return switch_to(next);
+}
+
+/* Wake all sleeping processes. */
+void proc_wakeup() {
+  int i;
+  for (i = 0; i < nr_proc; i ++) {
+    if (pcb[i].state == PROC_SLEEP) {
+      pcb[i].state = PROC_READY;
+      pcb[i].woken = true;
+    }
   }
-  else {
-    current = current_game;
-    count_game++;
+}
+
+/* Put the current process to sleep in its system call until a key is
+ * pressed or the next timer tick, unless it has been woken since it
+ * went to sleep last time. Return whether it sleeps, in which case the
+ * system call should end with proc_block(). */
+bool proc_sleep() {
+  if (current->woken) {
+    current->woken = false;
+    return false;
   }
-  _switch(&current->as); 
-  return current->tf;
+  current->state = PROC_SLEEP;
+  return true;
+}
+
+/* Leave the system call `r' of the sleeping process, which is done
+ * again when the process runs next time. */
+_RegSet* proc_block(_RegSet *r) {
+  SYSCALL_RESTART(r);
+  return schedule(r);
+}
+
+/* The timer interrupt. */
+_RegSet* proc_tick(_RegSet *prev) {
+  if (current == NULL) return NULL;
+
+  // a sleeping process only runs when no process is ready
+  bool idle = (current->state != PROC_READY);
+  if (idle)
+    idle_ticks ++;
+  else
+    current->ticks ++;
+
+  // sleeping processes wait for one tick at most
+  proc_wakeup();
+
+  if (idle || -- current->slice <= 0)
+    return schedule(prev);
+
+  int i;
+  for (i = 0; i < nr_proc; i ++) {
+    if (pcb[i].state == PROC_READY && pcb[i].priority > current->priority) {
+      current->tf = prev;
+      return switch_to(&pcb[i]);
+    }
+  }
+  return NULL;
+}
+
+/* The exit() system call. The memory of the current process is freed
+ * after leaving its address space. NEMU halts if no process can run. */
+_RegSet* proc_exit(int status) {
+  PCB *p = current;
+  Log("%s exits with %d", p->name, status);
+  p->state = PROC_EXIT;
+  PCB *next = pick_next();
+  if (next == NULL)
+    _halt(status);
+
+  _RegSet *tf = switch_to(next);
+  mm_free_pages(p);
+  _release(&p->as);
+  return tf;
+}
+
+void procinfo_read(void *buf, off_t offset, size_t len) {
+  static const char state_char[] = {
+    [PROC_UNUSED] = 'U', [PROC_READY] = 'R', [PROC_SLEEP] = 'S',
+    [PROC_STOP] = 'T', [PROC_EXIT] = 'X',
+  };
+  static char procinfo[512];
+  memset(procinfo, 0, sizeof(procinfo));
+  int n = snprintf(procinfo, sizeof(procinfo), "IDLE:%u\nPID STATE PRIO SLICE TICKS SWITCH NAME\n", idle_ticks);
+  int i;
+  for (i = 0; i < nr_proc && n < sizeof(procinfo); i ++) {
+    PCB *p = &pcb[i];
+    n += snprintf(procinfo + n, sizeof(procinfo) - n, "%d %c %d %d %u %u %s\n",
+        p->pid, state_char[p->state], p->priority, p->timeslice, p->ticks, p->nr_switch, p->name);
+  }
+  memcpy(buf, procinfo + offset, len);
 }
@@ -21,6 +21,12 @@ void ramdisk_write(const void *buf, off_t offset, size_t len) {
   memcpy(&ramdisk_start + offset, buf, len);
 }
 
+/* the address of `len' bytes starting from `offset' of ramdisk */
+void* ramdisk_addr(off_t offset, size_t len) {
+  assert(offset + len <= RAMDISK_SIZE);
+  return &ramdisk_start + offset;
+}
+
 void init_ramdisk() {
   Log("ramdisk info: start = %p, end = %p, size = %d bytes",
       &ramdisk_start, &ramdisk_end, RAMDISK_SIZE);
@@ -1,4 +1,4 @@
-#include "common.h"
+#include "proc.h"
 #include "syscall.h"
 
 int fs_open(const char *pathname, int flags, int mode);
@@ -7,6 +7,12 @@ ssize_t fs_write(int fd, const void *buf, size_t len);
 off_t fs_lseek(int fd, off_t offset, int whence);
 int fs_close(int fd);
 int mm_brk(uint32_t new_brk);
+uintptr_t mm_mmap(int fd, off_t offset, size_t len);
+int mm_munmap(uintptr_t addr, size_t len);
+_RegSet* proc_execve(const char *filename);
+_RegSet* proc_exit(int status);
+_RegSet* proc_block(_RegSet *r);
+_RegSet* schedule(_RegSet *prev);
 
 static inline _RegSet* sys_none(_RegSet *r) {
   SYSCALL_ARG1(r) = 1;
@@ -14,8 +20,7 @@ static inline _RegSet* sys_none(_RegSet *r) {
 }
 
 static inline _RegSet* sys_exit(_RegSet *r) {
-  _halt(SYSCALL_ARG2(r));
-  return NULL;
+  return proc_exit(SYSCALL_ARG2(r));
 }
 
 static inline _RegSet* sys_open(_RegSet *r) {
@@ -30,7 +35,13 @@ static inline _RegSet* sys_read(_RegSet *r) {
   int fd = (int)SYSCALL_ARG2(r);
   void *buf = (void *)SYSCALL_ARG3(r);
   size_t len = (size_t)SYSCALL_ARG4(r);
-  SYSCALL_ARG1(r) = fs_read(fd, buf, len);
+  ssize_t ret = fs_read(fd, buf, len);
+  // reading /dev/events may put the process to sleep or stop it
+  if (current->state == PROC_SLEEP)
+    return proc_block(r);
+  SYSCALL_ARG1(r) = ret;
+  if (current->state != PROC_READY)
+    return schedule(r);
   return NULL;
 }
 
@@ -64,6 +75,29 @@ static inline _RegSet* sys_brk(_RegSet *r) {
   return NULL;
 }
 
+static inline _RegSet* sys_mmap(_RegSet *r) {
+  int fd = (int)SYSCALL_ARG2(r);
+  off_t offset = (off_t)SYSCALL_ARG3(r);
+  size_t len = (size_t)SYSCALL_ARG4(r);
+  SYSCALL_ARG1(r) = mm_mmap(fd, offset, len);
+  return NULL;
+}
+
+static inline _RegSet* sys_munmap(_RegSet *r) {
+  uintptr_t addr = SYSCALL_ARG2(r);
+  size_t len = (size_t)SYSCALL_ARG3(r);
+  SYSCALL_ARG1(r) = mm_munmap(addr, len);
+  return NULL;
+}
+
+static inline _RegSet* sys_execve(_RegSet *r) {
+  const char *fname = (const char *)SYSCALL_ARG2(r);
+  _RegSet *next = proc_execve(fname);
+  if (next == NULL)
+    SYSCALL_ARG1(r) = -1;
+  return next;
+}
+
 _RegSet* do_syscall(_RegSet *r) {
   uintptr_t a[4];
   a[0] = SYSCALL_ARG1(r);
@@ -77,6 +111,9 @@ _RegSet* do_syscall(_RegSet *r) {
     case SYS_close: return sys_close(r);
     case SYS_lseek: return sys_lseek(r);
     case SYS_brk:   return sys_brk(r);
+    case SYS_mmap:  return sys_mmap(r);
+    case SYS_munmap: return sys_munmap(r);
+    case SYS_execve: return sys_execve(r);
     default: panic("Unhandled syscall ID = %d", a[0]);
   }
 
@@ -41,6 +41,17 @@ _DEFUN (memcpy, (out, in, length),
 	_CONST _PTR in _AND
 	size_t length)
 {
+#if defined(__i386__)
+  /* NEMU executes rep movs as a bulk copy */
+  int d0, d1, d2;
+  __asm__ __volatile__ ("rep movsl\n\t"
+      "movl %4, %%ecx\n\t"
+      "rep movsb"
+      : "=&c" (d0), "=&D" (d1), "=&S" (d2)
+      : "0" (length / 4), "rm" (length & 3), "1" (out), "2" (in)
+      : "memory");
+  return out;
+#else
   char *dst = (char *) out;
   char *src = (char *) in;
 
@@ -52,4 +63,5 @@ _DEFUN (memcpy, (out, in, length),
     }
 
   return save;
+#endif
 }
@@ -43,6 +43,15 @@ _DEFUN (memset, (m, c, n),
 	int c _AND
 	size_t n)
 {
+#if defined(__i386__)
+  /* NEMU executes rep stos as a bulk fill */
+  int d0, d1;
+  __asm__ __volatile__ ("rep stosb"
+      : "=&c" (d0), "=&D" (d1)
+      : "a" (c), "0" (n), "1" (m)
+      : "memory");
+  return m;
+#else
   char *s = (char *) m;
   int count;
   STRIDE *ip;
@@ -71,4 +80,5 @@ _DEFUN (memset, (m, c, n),
     }
 
   return m;
+#endif
 }
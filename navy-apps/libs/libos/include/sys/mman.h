@@ -0,0 +1,21 @@
+#ifndef __SYS_MMAN_H__
+#define __SYS_MMAN_H__
+
+#include <sys/types.h>
+
+#define PROT_NONE  0x0
+#define PROT_READ  0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC  0x4
+
+#define MAP_SHARED  0x01
+#define MAP_PRIVATE 0x02
+
+#define MAP_FAILED ((void *)-1)
+
+// Nanos-lite maps files in the ramdisk without copies, so only
+// read-only mappings are supported, and `addr' is ignored.
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int munmap(void *addr, size_t length);
+
+#endif
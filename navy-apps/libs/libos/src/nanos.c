@@ -4,6 +4,7 @@
 #include <sys/time.h>
 #include <assert.h>
 #include <time.h>
+#include <sys/mman.h>
 #include "syscall.h"
 
 // TODO: discuss with syscall interface
@@ -54,6 +55,20 @@ off_t _lseek(int fd, off_t offset, int whence) {
   return _syscall_(SYS_lseek, (uintptr_t)fd, (uintptr_t)offset, (uintptr_t)whence);
 }
 
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  if (prot & PROT_WRITE) return MAP_FAILED;
+  return (void *)_syscall_(SYS_mmap, (uintptr_t)fd, (uintptr_t)offset, (uintptr_t)length);
+}
+
+int munmap(void *addr, size_t length) {
+  return _syscall_(SYS_munmap, (uintptr_t)addr, (uintptr_t)length, 0);
+}
+
+int execve(const char *fname, char * const argv[], char *const envp[]) {
+  // it only returns on failure
+  return _syscall_(SYS_execve, (uintptr_t)fname, (uintptr_t)argv, (uintptr_t)envp);
+}
+
 // The code below is not used by Nanos-lite.
 // But to pass linking, they are defined as dummy functions
 
@@ -62,11 +77,6 @@ int _fstat(int fd, struct stat *buf) {
   return 0;
 }
 
-int execve(const char *fname, char * const argv[], char *const envp[]) {
-  assert(0);
-  return -1;
-}
-
 int _execve(const char *fname, char * const argv[], char *const envp[]) {
   return execve(fname, argv, envp);
 }
@@ -2,7 +2,9 @@
 #define __COMMON_H__
 
 // #define DEBUG
+// #define DISASM_LOG
 // #define DIFF_TEST
+// #define THREADED_CODE
 
 /* You will define this macro in PA2 */
 #define HAS_IOE
@@ -0,0 +1,26 @@
+#ifndef __BB_H__
+#define __BB_H__
+
+#include "common.h"
+
+/* Basic block engine.
+ * A block is a run of decoded instructions ending with a control
+ * transfer. Blocks are recorded while they are executed for the first
+ * time, and later executed back to back, with interrupts and devices
+ * only checked between blocks. A block also remembers the blocks
+ * executed after it, so that they can be found without a table lookup.
+ */
+
+#define BB_NR_HASH 4096
+#define BB_NR_BLOCK 4096
+#define BB_NR_INSTR (64 * 1024)
+#define BB_MAX_INSTR 64
+#define BB_MAX_BLK 4
+
+extern bool bb_engine;
+
+uint64_t bb_exec(uint64_t);
+uint64_t bb_abort(void);
+void bb_report(void);
+
+#endif
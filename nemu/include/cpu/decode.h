@@ -5,9 +5,12 @@
 
 #include "rtl.h"
 
-enum { OP_TYPE_REG, OP_TYPE_MEM, OP_TYPE_IMM, OP_TYPE_CREG };
+enum { REP_NONE, REP_E, REP_NE };
+
+enum { OP_TYPE_REG, OP_TYPE_MEM, OP_TYPE_IMM, OP_TYPE_CREG, OP_TYPE_NONE };
 
 #define OP_STR_SIZE 40
+#define INSTR_MAX_LEN 16  // bytes kept of an instruction
 
 typedef struct {
   uint32_t type;
@@ -19,6 +22,12 @@ typedef struct {
     int32_t simm;
   };
   rtlreg_t val;
+  bool load_val;
+  /* addressing mode of a memory operand, which is kept to
+   * recompute `addr' when a cached decoding is reused */
+  int8_t base_reg, index_reg;
+  uint8_t scale;
+  int32_t disp;
   char str[OP_STR_SIZE];
 } Operand;
 
@@ -26,11 +35,16 @@ typedef struct {
   uint32_t opcode;
   vaddr_t seq_eip;  // sequential eip
   bool is_operand_size_16;
+  uint8_t rep;      // REP_NONE, REP_E or REP_NE, set by the prefixes
   uint8_t ext_opcode;
   bool is_jmp;
   vaddr_t jmp_eip;
   Operand src, dest, src2;
-#ifdef DEBUG
+  /* the bytes of the instruction, which are either fetched into
+   * `instr_buf' or kept by the instruction cache */
+  const uint8_t *instr;
+  uint8_t instr_buf[INSTR_MAX_LEN];
+#ifdef DISASM_LOG
   char assembly[80];
   char asm_buf[128];
   char *p;
@@ -59,11 +73,47 @@ typedef union {
   uint8_t val;
 } SIB;
 
+/* rm->addr <- disp + base + index * 2^scale */
+static inline void calc_addr(Operand *rm) {
+  rtl_li(&rm->addr, rm->disp);
+  if (rm->base_reg != -1) {
+    rtl_add(&rm->addr, &rm->addr, &reg_l(rm->base_reg));
+  }
+  if (rm->index_reg != -1) {
+    rtl_shli(&t0, &reg_l(rm->index_reg), rm->scale);
+    rtl_add(&rm->addr, &rm->addr, &t0);
+  }
+}
+
 void load_addr(vaddr_t *, ModR_M *, Operand *);
 void read_ModR_M(vaddr_t *, Operand *, bool, Operand *, bool);
 void read_cr_r(vaddr_t *, Operand *, bool, Operand *, bool);
 
-void operand_write(Operand *, rtlreg_t *);
+static inline void operand_write(Operand *op, rtlreg_t* src) {
+  if (op->type == OP_TYPE_REG) { rtl_sr(op->reg, op->width, src); }
+  else if (op->type == OP_TYPE_MEM) { rtl_sm(&op->addr, op->width, src); }
+  else if (op->type == OP_TYPE_CREG) { rtl_scr(op->reg, src); }
+  else { assert(0); }
+}
+
+/* Reload the value of an operand whose descriptor comes from a
+ * cached decoding. Immediates are kept as they are.
+ */
+static inline void operand_reload(Operand *op) {
+  switch (op->type) {
+    case OP_TYPE_REG:
+      if (op->load_val) { rtl_lr(&op->val, op->reg, op->width); }
+      break;
+    case OP_TYPE_MEM:
+      calc_addr(op);
+      if (op->load_val) { rtl_lm(&op->val, &op->addr, op->width); }
+      break;
+    case OP_TYPE_CREG:
+      if (op->load_val) { rtl_lcr(&op->val, op->reg); }
+      break;
+    default: break;
+  }
+}
 
 /* shared by all helper functions */
 extern DecodeInfo decoding;
@@ -95,6 +145,7 @@ make_DHelper(mov_I2r);
 make_DHelper(mov_I2E);
 make_DHelper(mov_G2E);
 make_DHelper(mov_E2G);
+make_DHelper(movx_E2G);
 make_DHelper(lea_M2G);
 
 make_DHelper(gp2_1_E);
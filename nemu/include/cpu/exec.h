@@ -9,8 +9,12 @@ typedef void (*EHelper) (vaddr_t *);
 #include "cpu/decode.h"
 
 static inline uint32_t instr_fetch(vaddr_t *eip, int len) {
-  uint32_t instr = vaddr_read(*eip, len);
-#ifdef DEBUG
+  uint32_t instr = vaddr_fetch(*eip, len);
+  uint32_t offset = *eip - cpu.eip;
+  if (offset + len <= INSTR_MAX_LEN) {
+    memcpy(decoding.instr_buf + offset, &instr, len);
+  }
+#ifdef DISASM_LOG
   uint8_t *p_instr = (void *)&instr;
   int i;
   for (i = 0; i < len; i ++) {
@@ -21,6 +25,10 @@ static inline uint32_t instr_fetch(vaddr_t *eip, int len) {
   return instr;
 }
 
+static inline void update_eip(void) {
+  cpu.eip = (decoding.is_jmp ? (decoding.is_jmp = 0, decoding.jmp_eip) : decoding.seq_eip);
+}
+
 void rtl_setcc(rtlreg_t*, uint8_t);
 
 static inline const char* get_cc_name(int subcode) {
@@ -33,7 +41,7 @@ static inline const char* get_cc_name(int subcode) {
   return cc_name[subcode];
 }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
 #define print_asm(...) Assert(snprintf(decoding.assembly, 80, __VA_ARGS__) < 80, "buffer overflow!")
 #else
 #define print_asm(...)
@@ -0,0 +1,66 @@
+#ifndef __ICACHE_H__
+#define __ICACHE_H__
+
+#include "cpu/exec.h"
+
+/* Decoded instruction cache.
+ * An entry keeps the result of decoding the instruction at a guest eip,
+ * so that executing it again needs neither instruction fetching nor
+ * opcode table lookup. Entries are invalidated by writes to the physical
+ * memory blocks they are decoded from, and all of them are flushed when
+ * cr0 or cr3 is written.
+ */
+
+#define ICACHE_NR_ENTRY 8192
+#define ICACHE_BLK_SHIFT 8
+#define ICACHE_NR_BLK (PMEM_MAX_SIZE >> ICACHE_BLK_SHIFT)
+
+typedef struct {
+  uint32_t opcode;
+  uint8_t ext_opcode;
+  bool is_operand_size_16;
+  uint8_t rep;
+  int len;
+  vaddr_t jmp_eip;
+  EHelper execute;
+  const char *name;   // name of the execution helper, for profiling
+  Operand src, dest, src2;
+} DecodedInstr;
+
+typedef struct {
+  vaddr_t eip;
+  uint32_t cr3;
+  uint32_t epoch;
+  /* physical memory blocks covered by the instruction,
+   * and their generations when it is decoded */
+  uint32_t blk[2];
+  uint32_t gen[2];
+  uint8_t instr_bytes[INSTR_MAX_LEN];
+  DecodedInstr instr;
+} ICacheEntry;
+
+extern uint8_t icache_blk_has_code[];
+extern uint32_t icache_blk_gen[];
+extern uint32_t icache_epoch;
+extern uint32_t icache_nr_inval;
+
+static inline uint32_t icache_cr3(void) {
+  return (cpu.PG ? cpu.cr3 : 0);
+}
+
+ICacheEntry* icache_lookup(vaddr_t);
+void exec_decoded(const DecodedInstr *, vaddr_t *);
+void icache_invalidate_blk(uint32_t, uint32_t);
+void icache_flush(void);
+void icache_report(void);
+
+/* called by the bus before `len' bytes starting at `addr' are written */
+static inline void icache_check_write(paddr_t addr, int len) {
+  uint32_t blk_begin = addr >> ICACHE_BLK_SHIFT;
+  uint32_t blk_end = (addr + len - 1) >> ICACHE_BLK_SHIFT;
+  if (icache_blk_has_code[blk_begin] | icache_blk_has_code[blk_end]) {
+    icache_invalidate_blk(blk_begin, blk_end);
+  }
+}
+
+#endif
@@ -43,7 +43,7 @@ typedef struct {
       uint32_t SF   :1;
       uint32_t      :1;
       uint32_t IF   :1;
-      uint32_t      :1;
+      uint32_t DF   :1;
       uint32_t OF   :1;
       uint32_t      :20;
     };
@@ -65,6 +65,7 @@ typedef struct {
     uint32_t cr0;
   };
   
+  uint32_t cr2;
   uint32_t cr3;
   
   bool INTR;
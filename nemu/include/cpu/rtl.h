@@ -114,24 +114,75 @@ static inline void rtl_sr(int r, int width, const rtlreg_t* src1) {
 static inline void rtl_lcr(rtlreg_t* dest, int index) {
   switch (index) {
     case 0: *dest = cpu.cr0; return;
+    case 2: *dest = cpu.cr2; return;
     case 3: *dest = cpu.cr3; return;
     default: assert(0);
   }
 }
 
+void icache_flush(void);
+
 static inline void rtl_scr(int index, const rtlreg_t* src) {
   switch (index) {
-    case 0: cpu.cr0 = *src; return;
-    case 3: cpu.cr3 = *src; return;
+    case 0: cpu.cr0 = *src; icache_flush(); tlb_flush(); return;
+    case 2: cpu.cr2 = *src; return;
+    case 3: cpu.cr3 = *src; icache_flush(); tlb_flush(); return;
     default: assert(0);
   }
 }
 
+/* CF, OF, ZF and SF are evaluated lazily. Arithmetic and logic helpers
+ * only record the operation with rtl_update_eflags(), and the flags are
+ * computed from the record when someone reads or writes any of them.
+ */
+enum { LAZY_NONE, LAZY_ADD, LAZY_ADC, LAZY_SUB, LAZY_SBB, LAZY_INC, LAZY_DEC, LAZY_LOGIC };
+
+typedef struct {
+  int op;
+  int width;
+  rtlreg_t dest, src, result;
+} LazyEflags;
+
+extern LazyEflags lazy_eflags;
+
+void lazy_eflags_eval(void);
+
+static inline void rtl_eval_eflags(void) {
+  if (lazy_eflags.op != LAZY_NONE) {
+    lazy_eflags_eval();
+  }
+}
+
+static inline void rtl_update_eflags(int op, const rtlreg_t* dest, const rtlreg_t* src,
+    const rtlreg_t* result, int width) {
+  if (op == LAZY_INC || op == LAZY_DEC) {
+    // CF is kept, so the last operation should be settled
+    rtl_eval_eflags();
+  }
+  lazy_eflags.op = op;
+  lazy_eflags.width = width;
+  lazy_eflags.dest = *dest;
+  lazy_eflags.src = (src == NULL ? 0 : *src);
+  lazy_eflags.result = *result;
+}
+
+static inline void rtl_get_eflags(rtlreg_t* dest) {
+  rtl_eval_eflags();
+  *dest = cpu.eflags;
+}
+
+static inline void rtl_set_eflags(const rtlreg_t* src) {
+  lazy_eflags.op = LAZY_NONE;
+  cpu.eflags = *src;
+}
+
 #define make_rtl_setget_eflags(f) \
   static inline void concat(rtl_set_, f) (const rtlreg_t* src) { \
+    rtl_eval_eflags(); \
     cpu.f = *src; \
   } \
   static inline void concat(rtl_get_, f) (rtlreg_t* dest) { \
+    rtl_eval_eflags(); \
     *dest = cpu.f; \
   }
 
@@ -158,10 +209,13 @@ static inline void rtl_sext(rtlreg_t* dest, const rtlreg_t* src1, int width) {
 
 // only for 32bit
 static inline void rtl_push(const rtlreg_t* src1) {
+  // M[esp - 4] <- src1
   // esp <- esp - 4
-  // M[esp] <- src1
-  rtl_subi(&reg_l(R_ESP), &reg_l(R_ESP), 4);
-  rtl_sm(&reg_l(R_ESP), 4, src1);
+  // so that esp is kept if the write causes a page fault
+  rtlreg_t addr;
+  rtl_subi(&addr, &reg_l(R_ESP), 4);
+  rtl_sm(&addr, 4, src1);
+  rtl_mv(&reg_l(R_ESP), &addr);
 }
 
 // only for 32bit
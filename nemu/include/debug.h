@@ -26,6 +26,8 @@ extern FILE* log_fp;
         __FILE__, __LINE__, __func__, ## __VA_ARGS__); \
   } while (0)
 
+void itrace_assert_fail(void);
+
 #define Assert(cond, ...) \
   do { \
     if (!(cond)) { \
@@ -33,6 +35,7 @@ extern FILE* log_fp;
       fprintf(stderr, "\33[1;31m"); \
       fprintf(stderr, __VA_ARGS__); \
       fprintf(stderr, "\33[0m\n"); \
+      itrace_assert_fail(); \
       assert(cond); \
     } \
   } while (0)
@@ -0,0 +1,17 @@
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+#include "common.h"
+
+/* Device backend options, set by the monitor before init_device().
+ * A headless machine opens no window and polls no SDL events. The screen
+ * is only kept in vmem, and keys can be replayed from a script instead.
+ */
+
+extern bool device_headless;
+extern const char *vga_checksum_file;  // checksum of every frame
+extern uint32_t vga_dump_frame;        // the frame to dump to vga_dump_file
+extern const char *vga_dump_file;
+extern const char *key_script_file;
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include "common.h"
+
+/* Device event scheduler.
+ * Time is counted in guest instructions. Each event is fired when the
+ * clock reaches its deadline, and then rescheduled after its period.
+ * cpu_exec() only compares the clock with the nearest deadline, so
+ * devices cost nothing between events, and a run is reproducible.
+ */
+
+#define NR_EVENT 8
+
+/* Frequencies of devices are converted with a nominal speed of the guest. */
+#define GUEST_IPS 50000000
+
+typedef void(*event_handler_t)(void);
+
+extern uint64_t event_now;
+extern uint64_t event_deadline;
+
+int add_event(const char *, uint64_t, event_handler_t);
+void event_set_period(int, uint64_t);
+void event_reset(uint64_t);
+void event_dispatch(void);
+
+/* called by cpu_exec() after `n' guest instructions are executed */
+static inline void event_advance(uint64_t n) {
+  event_now += n;
+  if (event_now >= event_deadline) {
+    event_dispatch();
+  }
+}
+
+#endif
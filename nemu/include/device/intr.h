@@ -0,0 +1,19 @@
+#ifndef __INTR_H__
+#define __INTR_H__
+
+#include "common.h"
+
+/* Interrupt controller.
+ * Each device raises its IRQ line, which is delivered as the interrupt
+ * IRQ_BASE + line when IF is set. A raised line is pending until it is
+ * delivered, and lines can be masked by the guest.
+ */
+
+#define IRQ_BASE     32
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+
+void dev_raise_intr(int);
+int intr_ack(void);
+
+#endif
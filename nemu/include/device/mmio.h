@@ -6,7 +6,10 @@
 typedef void(*mmio_callback_t)(paddr_t, int, bool);
 
 void* add_mmio_map(paddr_t, int, mmio_callback_t);
+void* add_mmio_mem_map(paddr_t, int);
+bool mmio_sync_dirty(void *, uint8_t *);
 int is_mmio(paddr_t);
+uint8_t* mmio_host(paddr_t, int, bool);
 
 uint32_t mmio_read(paddr_t, int, int);
 void mmio_write(paddr_t, int, uint32_t, int);
@@ -2,8 +2,22 @@
 #define __MEMORY_H__
 
 #include "common.h"
+#include <sys/types.h>
+#include <setjmp.h>
 
-extern uint8_t pmem[];
+/* The size of pmem is set at startup, up to PMEM_MAX_SIZE. AM assumes
+ * PMEM_SIZE, so its images need at least that much. */
+#define PMEM_SIZE (128 * 1024 * 1024)
+#define PMEM_MAX_SIZE (1024 * 1024 * 1024)
+
+extern uint8_t *pmem;
+extern uint32_t pmem_size;
+
+/* one byte for each page of pmem: PMEM_TOUCHED once the page is written,
+ * and PMEM_DIRTY if it is written since the last pmem_checkpoint() */
+extern uint8_t pmem_touched[];
+#define PMEM_TOUCHED 0x1
+#define PMEM_DIRTY   0x2
 
 /* convert the guest physical address in the guest program to host virtual address in NEMU */
 #define guest_to_host(p) ((void *)(pmem + (unsigned)p))
@@ -11,8 +25,28 @@ extern uint8_t pmem[];
 #define host_to_guest(p) ((paddr_t)((void *)p - (void *)pmem))
 
 uint32_t vaddr_read(vaddr_t, int);
+uint32_t vaddr_fetch(vaddr_t, int);
 uint32_t paddr_read(paddr_t, int);
 void vaddr_write(vaddr_t, int, uint32_t);
 void paddr_write(paddr_t, int, uint32_t);
+uint8_t* vaddr_host(vaddr_t, int, bool);
+paddr_t page_translate(vaddr_t);
+void init_pmem(uint32_t);
+void pmem_reset(void);
+void pmem_touch(paddr_t, uint32_t);
+bool pmem_map_file(paddr_t, int, off_t, uint32_t);
+void pmem_checkpoint(void);
+void pmem_rollback(void);
+uint32_t pmem_dirty_pages(const uint32_t **, const uint8_t **);
+void tlb_flush(void);
+void tlb_invalidate(vaddr_t);
+
+/* Set while instructions are executed. An access to a page which is not
+ * present aborts the instruction by jumping there, with cpu.cr2 and the
+ * error code `pf_err' set. Otherwise NEMU stops with an assertion. */
+extern jmp_buf *pf_jmp;
+extern uint32_t pf_err;
+#define PF_ERR_W 0x2
+void tlb_report(void);
 
 #endif
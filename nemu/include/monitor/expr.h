@@ -3,6 +3,27 @@
 
 #include "common.h"
 
+#define EXPR_MAX_CODE 32
+
+/* An instruction of the postfix code of an expression. Operands are
+ * integers and registers, which are read when the code is evaluated. */
+typedef struct {
+  int op;
+  int width;
+  union {
+    int32_t imm;
+    const void *reg;
+  };
+} ExprInstr;
+
+typedef struct {
+  int nr_code;
+  ExprInstr code[EXPR_MAX_CODE];
+} ExprCode;
+
 uint32_t expr(char *, bool *);
+bool expr_compile(char *, ExprCode *);
+uint32_t expr_run(const ExprCode *, bool *);
+bool expr_is_const_deref(const ExprCode *, vaddr_t *);
 
 #endif
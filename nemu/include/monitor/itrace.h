@@ -0,0 +1,22 @@
+#ifndef __ITRACE_H__
+#define __ITRACE_H__
+
+#include "common.h"
+
+/* Instruction trace.
+ * The eip and the bytes of each executed instruction are kept in a ring
+ * buffer in binary, and only turned into text when the trace is dumped,
+ * e.g. after a failed assertion. Like the profiler, the trace is recorded
+ * by the interpreter only.
+ */
+
+#define ITRACE_SIZE 4096
+#define ITRACE_DUMP_DEFAULT 16
+
+extern bool itrace_enable;
+
+void itrace_record(vaddr_t, int, const uint8_t *);
+void itrace_print(vaddr_t, int, const uint8_t *);
+void itrace_dump(int);
+
+#endif
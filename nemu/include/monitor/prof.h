@@ -0,0 +1,20 @@
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include "common.h"
+
+/* Execution profiler.
+ * When enabled, every executed instruction is counted by its opcode and
+ * by its eip. The counts per execution helper are gathered from the eip
+ * table when reporting. Profiling runs on the interpreter only, since the
+ * block engine does not execute instructions one by one.
+ */
+
+extern bool prof_enable;
+extern char *prof_file;
+
+void prof_record(vaddr_t, uint32_t);
+void prof_report(int);
+void prof_dump(const char *);
+
+#endif
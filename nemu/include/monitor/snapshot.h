@@ -0,0 +1,22 @@
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include "common.h"
+
+/* Machine state snapshot.
+ * A snapshot holds the CPU state, the guest clock, the non-zero pages of
+ * pmem and the state registered by devices with snapshot_add_region().
+ * It is compressed with gzip if the file name ends with ".gz". Devices
+ * keeping state derived from their regions refresh it in a hook
+ * registered with snapshot_add_hook(), which is called after loading.
+ */
+
+#define NR_SNAPSHOT_REGION 16
+#define NR_SNAPSHOT_HOOK 4
+
+void snapshot_add_region(const char *, void *, size_t);
+void snapshot_add_hook(void (*)(void));
+bool snapshot_save(const char *);
+bool snapshot_load(const char *);
+
+#endif
@@ -2,18 +2,29 @@
 #define __WATCHPOINT_H__
 
 #include "common.h"
+#include "monitor/expr.h"
 
 bool insert_wp(char *);
 bool delete_wp(int);
 void print_all_wp();
 bool check_watchpoints();
+void wp_check_write(vaddr_t, int);
 
 typedef struct watchpoint {
   int NO;
   struct watchpoint *next;
 	char expr[64];
 	uint32_t pre_val;
+	ExprCode code;
+	/* a watchpoint on `*ADDR' is checked only when
+	 * the guest writes [addr, addr + 4) */
+	bool is_trap;
+	vaddr_t addr;
 
 } WP;
 
+/* the number of watchpoints checked after every instruction,
+ * and the number of write traps */
+extern int nr_expr_wp, nr_trap_wp;
+
 #endif
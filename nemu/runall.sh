@@ -19,6 +19,8 @@ fi
 
 files=`ls $AM_HOME/tests/cputest/build/*-x86-nemu.bin`
 ori_log="build/nemu-log.txt"
+total_instr=0
+total_us=0
 
 for file in $files; do
   base=`basename $file | sed -e 's/-x86-nemu.bin//'`
@@ -27,7 +29,15 @@ for file in $files; do
   $nemu -b -l $ori_log $file &> $logfile
 
   if (grep 'nemu: HIT GOOD TRAP' $logfile > /dev/null) then
-    echo -e "\033[1;32mPASS!\033[0m"
+    echo -en "\033[1;32mPASS!\033[0m"
+    stat=`grep -o 'total guest instructions = [0-9]*, time = [0-9]* us' $logfile | tail -1`
+    if [ -n "$stat" ]; then
+      set -- $stat
+      printf " %9d instr %8d us" ${5%,} $8
+      total_instr=$((total_instr + ${5%,}))
+      total_us=$((total_us + $8))
+    fi
+    echo
     rm $logfile
   else
     echo -e "\033[1;31mFAIL!\033[0m see $logfile for more information"
@@ -37,3 +47,8 @@ for file in $files; do
     fi
   fi
 done
+
+if [ $total_us -gt 0 ]; then
+  mips=$((total_instr * 100 / total_us))
+  printf "total guest instructions = %d, time = %d us, %d.%02d MIPS\n" $total_instr $total_us $((mips / 100)) $((mips % 100))
+fi
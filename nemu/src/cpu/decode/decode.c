@@ -17,7 +17,7 @@ static inline make_DopHelper(I) {
   op->imm = instr_fetch(eip, op->width);
   rtl_li(&op->val, op->imm);
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   snprintf(op->str, OP_STR_SIZE, "$0x%x", op->imm);
 #endif
 }
@@ -41,7 +41,7 @@ static inline make_DopHelper(SI) {
   if (load_val)
     rtl_li(&op->val, op->simm);
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   snprintf(op->str, OP_STR_SIZE, "$0x%x", op->simm);
 #endif
 }
@@ -53,11 +53,12 @@ static inline make_DopHelper(SI) {
 static inline make_DopHelper(a) {
   op->type = OP_TYPE_REG;
   op->reg = R_EAX;
+  op->load_val = load_val;
   if (load_val) {
     rtl_lr(&op->val, R_EAX, op->width);
   }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   snprintf(op->str, OP_STR_SIZE, "%%%s", reg_name(R_EAX, op->width));
 #endif
 }
@@ -69,11 +70,12 @@ static inline make_DopHelper(a) {
 static inline make_DopHelper(r) {
   op->type = OP_TYPE_REG;
   op->reg = decoding.opcode & 0x7;
+  op->load_val = load_val;
   if (load_val) {
     rtl_lr(&op->val, op->reg, op->width);
   }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   snprintf(op->str, OP_STR_SIZE, "%%%s", reg_name(op->reg, op->width));
 #endif
 }
@@ -95,12 +97,15 @@ static inline void decode_op_rm(vaddr_t *eip, Operand *rm, bool load_rm_val, Ope
 /* Ob, Ov */
 static inline make_DopHelper(O) {
   op->type = OP_TYPE_MEM;
-  op->addr = instr_fetch(eip, 4);
+  op->disp = instr_fetch(eip, 4);
+  op->base_reg = op->index_reg = -1;
+  calc_addr(op);
+  op->load_val = load_val;
   if (load_val) {
     rtl_lm(&op->val, &op->addr, op->width);
   }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   snprintf(op->str, OP_STR_SIZE, "0x%x", op->addr);
 #endif
 }
@@ -127,6 +132,14 @@ make_DHelper(mov_E2G) {
   decode_op_rm(eip, id_src, true, id_dest, false);
 }
 
+/* Gv <- Eb
+ * Gv <- Ew
+ * use for movzx and movsx */
+make_DHelper(movx_E2G) {
+  id_dest->width = decoding.is_operand_size_16 ? 2 : 4;
+  decode_op_rm(eip, id_src, true, id_dest, false);
+}
+
 make_DHelper(lea_M2G) {
   decode_op_rm(eip, id_src, false, id_dest, false);
 }
@@ -220,7 +233,7 @@ make_DHelper(gp2_1_E) {
   id_src->type = OP_TYPE_IMM;
   id_src->imm = 1;
   rtl_li(&id_src->val, 1);
-#ifdef DEBUG
+#ifdef DISASM_LOG
   sprintf(id_src->str, "$1");
 #endif
 }
@@ -228,9 +241,11 @@ make_DHelper(gp2_1_E) {
 make_DHelper(gp2_cl2E) {
   decode_op_rm(eip, id_dest, true, NULL, false);
   id_src->type = OP_TYPE_REG;
+  id_src->width = 1;
   id_src->reg = R_CL;
+  id_src->load_val = true;
   rtl_lr_b(&id_src->val, R_CL);
-#ifdef DEBUG
+#ifdef DISASM_LOG
   sprintf(id_src->str, "%%cl");
 #endif
 }
@@ -277,9 +292,11 @@ make_DHelper(in_I2a) {
 
 make_DHelper(in_dx2a) {
   id_src->type = OP_TYPE_REG;
+  id_src->width = 2;
   id_src->reg = R_DX;
+  id_src->load_val = true;
   rtl_lr_w(&id_src->val, R_DX);
-#ifdef DEBUG
+#ifdef DISASM_LOG
   sprintf(id_src->str, "(%%dx)");
 #endif
 
@@ -296,31 +313,26 @@ make_DHelper(out_a2dx) {
   decode_op_a(eip, id_src, true);
 
   id_dest->type = OP_TYPE_REG;
+  id_dest->width = 2;
   id_dest->reg = R_DX;
+  id_dest->load_val = true;
   rtl_lr_w(&id_dest->val, R_DX);
-#ifdef DEBUG
+#ifdef DISASM_LOG
   sprintf(id_dest->str, "(%%dx)");
 #endif
 }
 
-void operand_write(Operand *op, rtlreg_t* src) {
-  if (op->type == OP_TYPE_REG) { rtl_sr(op->reg, op->width, src); }
-  else if (op->type == OP_TYPE_MEM) { rtl_sm(&op->addr, op->width, src); }
-  else if (op->type == OP_TYPE_CREG) { rtl_scr(op->reg, src); }
-  else { assert(0); }
-}
-
 make_DHelper(r2a) {
   decode_op_a(eip, id_dest, true);
   decode_op_r(eip, id_src, true);
 }
 
-// cr0, cr3 <- r
+// cr0, cr2, cr3 <- r
 make_DHelper(r2cr) {
   read_cr_r(eip, id_dest, false, id_src, true);
 }
 
-// r <- cr0, cr3
+// r <- cr0, cr2, cr3
 make_DHelper(cr2r) {
   read_cr_r(eip, id_src, true, id_dest, false);
 }
@@ -7,7 +7,6 @@ void load_addr(vaddr_t *eip, ModR_M *m, Operand *rm) {
   int32_t disp = 0;
   int disp_size = 4;
   int base_reg = -1, index_reg = -1, scale = 0;
-  rtl_li(&rm->addr, 0);
 
   if (m->R_M == R_ESP) {
     SIB s;
@@ -32,20 +31,15 @@ void load_addr(vaddr_t *eip, ModR_M *m, Operand *rm) {
     /* has disp */
     disp = instr_fetch(eip, disp_size);
     if (disp_size == 1) { disp = (int8_t)disp; }
-
-    rtl_addi(&rm->addr, &rm->addr, disp);
-  }
-
-  if (base_reg != -1) {
-    rtl_add(&rm->addr, &rm->addr, &reg_l(base_reg));
   }
 
-  if (index_reg != -1) {
-    rtl_shli(&t0, &reg_l(index_reg), scale);
-    rtl_add(&rm->addr, &rm->addr, &t0);
-  }
+  rm->disp = disp;
+  rm->base_reg = base_reg;
+  rm->index_reg = index_reg;
+  rm->scale = scale;
+  calc_addr(rm);
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
   char disp_buf[16];
   char base_buf[8];
   char index_buf[8];
@@ -84,11 +78,12 @@ void read_ModR_M(vaddr_t *eip, Operand *rm, bool load_rm_val, Operand *reg, bool
   if (reg != NULL) {
     reg->type = OP_TYPE_REG;
     reg->reg = m.reg;
+    reg->load_val = load_reg_val;
     if (load_reg_val) {
       rtl_lr(&reg->val, reg->reg, reg->width);
     }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
     snprintf(reg->str, OP_STR_SIZE, "%%%s", reg_name(reg->reg, reg->width));
 #endif
   }
@@ -96,16 +91,18 @@ void read_ModR_M(vaddr_t *eip, Operand *rm, bool load_rm_val, Operand *reg, bool
   if (m.mod == 3) {
     rm->type = OP_TYPE_REG;
     rm->reg = m.R_M;
+    rm->load_val = load_rm_val;
     if (load_rm_val) {
       rtl_lr(&rm->val, m.R_M, rm->width);
     }
 
-#ifdef DEBUG
+#ifdef DISASM_LOG
     sprintf(rm->str, "%%%s", reg_name(m.R_M, rm->width));
 #endif
   }
   else {
     load_addr(eip, &m, rm);
+    rm->load_val = load_rm_val;
     if (load_rm_val) {
       rtl_lm(&rm->val, &rm->addr, rm->width);
     }
@@ -122,11 +119,13 @@ void read_cr_r(vaddr_t *eip, Operand *creg, bool load_creg_val, Operand *reg, bo
   
   creg->type = OP_TYPE_CREG;
   creg->reg = m.reg;
+  creg->load_val = load_creg_val;
   if (load_creg_val) 
     rtl_lcr(&creg->val, creg->reg);
       
   reg->type = OP_TYPE_REG;
   reg->reg = m.R_M;
+  reg->load_val = load_reg_val;
   if (load_reg_val) 
     rtl_lr(&reg->val, reg->reg, 4);
 
@@ -13,7 +13,17 @@ make_EHelper(cltd);
 make_EHelper(cwtl);
 make_EHelper(xchg);
 
+make_EHelper(movs);
+make_EHelper(stos);
+make_EHelper(lods);
+make_EHelper(cmps);
+make_EHelper(scas);
+make_EHelper(cld);
+make_EHelper(std);
+
 make_EHelper(operand_size);
+make_EHelper(rep);
+make_EHelper(repne);
 
 make_EHelper(nop);
 make_EHelper(inv);
@@ -55,6 +65,7 @@ make_EHelper(test);
 make_EHelper(in);
 make_EHelper(out);
 make_EHelper(lidt);
+make_EHelper(invlpg);
 make_EHelper(iret);
 make_EHelper(int);
 
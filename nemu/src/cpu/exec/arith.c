@@ -4,19 +4,7 @@ make_EHelper(add) {
   rtl_add(&t2, &id_dest->val, &id_src->val);
   operand_write(id_dest, &t2);
 
-  rtl_update_ZFSF(&t2, id_dest->width);
-
-  // CF = (result < dest)
-  rtl_sltu(&t0, &t2, &id_dest->val);
-  rtl_set_CF(&t0);
-
-  // OF = (msb(dest) == msb(src) && msb(dest) != msb(result))
-  rtl_xor(&t0, &id_dest->val, &id_src->val);
-  rtl_not(&t0);
-  rtl_xor(&t1, &id_dest->val, &t2);
-  rtl_and(&t0, &t0, &t1);
-  rtl_msb(&t0, &t0, id_dest->width);
-  rtl_set_OF(&t0);
+  rtl_update_eflags(LAZY_ADD, &id_dest->val, &id_src->val, &t2, id_dest->width);
 
   print_asm_template2(add);
 }
@@ -25,36 +13,14 @@ make_EHelper(sub) {
   rtl_sub(&t0, &id_dest->val, &id_src->val);
   operand_write(id_dest, &t0);
   
-  rtl_update_ZFSF(&t0, id_dest->width);
-  
-  // OF = (msb(dest) != msb(src) && msb(dest) != msb(result))
-  rtl_xor(&t1, &id_dest->val, &id_src->val);
-  rtl_xor(&t2, &id_dest->val, &t0);
-  rtl_and(&t1, &t1, &t2);
-  rtl_msb(&t1, &t1, id_dest->width);
-  rtl_set_OF(&t1);
-  
-  // CF = (id_dest < result)
-  rtl_sltu(&t1, &id_dest->val, &t0);
-  rtl_set_CF(&t1);
+  rtl_update_eflags(LAZY_SUB, &id_dest->val, &id_src->val, &t0, id_dest->width);
 
   print_asm_template2(sub);
 }
 
 make_EHelper(cmp) {
   rtl_sub(&t0, &id_dest->val, &id_src->val);
-  rtl_update_ZFSF(&t0, id_dest->width);
-  
-  // OF = (msb(dest) != msb(src) && msb(dest) != msb(result))
-  rtl_xor(&t1, &id_dest->val, &id_src->val);
-  rtl_xor(&t2, &id_dest->val, &t0);
-  rtl_and(&t1, &t1, &t2);
-  rtl_msb(&t1, &t1, id_dest->width);
-  rtl_set_OF(&t1);
-  
-  // CF = (id_dest < result)
-  rtl_sltu(&t1, &id_dest->val, &t0);
-  rtl_set_CF(&t1);
+  rtl_update_eflags(LAZY_SUB, &id_dest->val, &id_src->val, &t0, id_dest->width);
 
   print_asm_template2(cmp);
 }
@@ -63,19 +29,8 @@ make_EHelper(inc) {
   rtl_addi(&t2, &id_dest->val, 1);
   operand_write(id_dest, &t2);
 
-  rtl_update_ZFSF(&t2, id_dest->width);
-
-  // CF = (result < dest)
-  // rtl_sltu(&t0, &t2, &id_dest->val);
-  // rtl_set_CF(&t0);
-
-  // OF = (msb(dest) == msb(src) && msb(dest) != msb(result))
-  rtl_xor(&t0, &id_dest->val, &id_src->val);
-  rtl_not(&t0);
-  rtl_xor(&t1, &id_dest->val, &t2);
-  rtl_and(&t0, &t0, &t1);
-  rtl_msb(&t0, &t0, id_dest->width);
-  rtl_set_OF(&t0);
+  // CF is not affected, and src is 1 and not decoded
+  rtl_update_eflags(LAZY_INC, &id_dest->val, NULL, &t2, id_dest->width);
 
   print_asm_template1(inc);
 }
@@ -84,37 +39,18 @@ make_EHelper(dec) {
   rtl_subi(&t0, &id_dest->val, 1);
   operand_write(id_dest, &t0);
   
-  rtl_update_ZFSF(&t0, id_dest->width);
-  
-  // OF = (msb(dest) != msb(src) && msb(dest) != msb(result))
-  rtl_xor(&t1, &id_dest->val, &id_src->val);
-  rtl_xor(&t2, &id_dest->val, &t0);
-  rtl_and(&t1, &t1, &t2);
-  rtl_msb(&t1, &t1, id_dest->width);
-  rtl_set_OF(&t1);
-  
-  // CF = (id_dest < result)
-  // rtl_sltu(&t1, &id_dest->val, &t0);
-  // rtl_set_CF(&t1);
+  // CF is not affected, and src is 1 and not decoded
+  rtl_update_eflags(LAZY_DEC, &id_dest->val, NULL, &t0, id_dest->width);
 
   print_asm_template1(dec);
 }
 
 make_EHelper(neg) {
-  // CF = (dest != 0)
-  rtl_neq0(&t0, &id_dest->val);
-  rtl_set_CF(&t0);
-
   rtl_sub(&t0, &tzero, &id_dest->val);
   operand_write(id_dest, &t0);
   
-  rtl_update_ZFSF(&t0, id_dest->width);
-  
-  // OF = (msb(result) == msb(dest)) 
-  rtl_xor(&t0, &t0, &id_dest->val);
-  rtl_not(&t0);
-  rtl_msb(&t0, &t0, id_dest->width);
-  rtl_set_OF(&t0);
+  // the same as 0 - dest
+  rtl_update_eflags(LAZY_SUB, &tzero, &id_dest->val, &t0, id_dest->width);
   
   print_asm_template1(neg);
 }
@@ -125,17 +61,8 @@ make_EHelper(adc) {
   rtl_add(&t2, &t2, &t1);
   operand_write(id_dest, &t2);
 
-  rtl_update_ZFSF(&t2, id_dest->width);
-
-  rtl_sltu(&t0, &t2, &id_dest->val);
-  rtl_set_CF(&t0);
-
-  rtl_xor(&t0, &id_dest->val, &id_src->val);
-  rtl_not(&t0);
-  rtl_xor(&t1, &id_dest->val, &t2);
-  rtl_and(&t0, &t0, &t1);
-  rtl_msb(&t0, &t0, id_dest->width);
-  rtl_set_OF(&t0);
+  // the carry-in is still in CF when the flags are evaluated
+  rtl_update_eflags(LAZY_ADC, &id_dest->val, &id_src->val, &t2, id_dest->width);
 
   print_asm_template2(adc);
 }
@@ -146,16 +73,8 @@ make_EHelper(sbb) {
   rtl_sub(&t2, &t2, &t1);
   operand_write(id_dest, &t2);
 
-  rtl_update_ZFSF(&t2, id_dest->width);
-
-  rtl_sltu(&t0, &id_dest->val, &t2);
-  rtl_set_CF(&t0);
-
-  rtl_xor(&t0, &id_dest->val, &id_src->val);
-  rtl_xor(&t1, &id_dest->val, &t2);
-  rtl_and(&t0, &t0, &t1);
-  rtl_msb(&t0, &t0, id_dest->width);
-  rtl_set_OF(&t0);
+  // the borrow-in is still in CF when the flags are evaluated
+  rtl_update_eflags(LAZY_SBB, &id_dest->val, &id_src->val, &t2, id_dest->width);
 
   print_asm_template2(sbb);
 }
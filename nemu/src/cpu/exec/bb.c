@@ -0,0 +1,403 @@
+#include "cpu/exec.h"
+#include "cpu/icache.h"
+#include "cpu/bb.h"
+#include "monitor/monitor.h"
+#include "all-instr.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef THREADED_CODE
+/* An instruction in threaded code is a handler for each of its operands,
+ * specialized by the form of the operand, followed by a handler running
+ * the instruction. Handlers are labels in bb_run(), and one jumps to the
+ * next with computed goto.
+ */
+typedef struct {
+  const void *handler;
+  union {
+    const Operand *opnd;
+    const DecodedInstr *instr;
+  };
+} ThreadedOp;
+
+/* forms of operands, with loading instantiated for each width */
+enum {
+  TOP_copy, TOP_reg_b, TOP_reg_w, TOP_reg_l,
+  TOP_mem, TOP_mem_b, TOP_mem_w, TOP_mem_l, TOP_creg,
+  TOP_NR_FORM
+};
+
+/* handlers of src, dest and src2 come first */
+#define TOP_exec (3 * TOP_NR_FORM)
+#define NR_TOP (TOP_exec + 1)
+#define TOP_MAX_PER_INSTR 4
+#endif
+
+typedef struct BBlock {
+  vaddr_t eip;
+  uint32_t cr3;
+  uint32_t epoch;
+  /* physical memory blocks (in the sense of icache) the code
+   * comes from, and their generations when it is recorded */
+  int nr_blk;
+  uint32_t blk[BB_MAX_BLK];
+  uint32_t gen[BB_MAX_BLK];
+
+  int nr_instr;
+  DecodedInstr *instr;
+  /* the address next to the last instruction */
+  vaddr_t end_eip;
+  /* chained successors: [0] for falling through, [1] for the others */
+  struct BBlock *succ[2];
+#ifdef THREADED_CODE
+  ThreadedOp *code;
+#endif
+} BBlock;
+
+bool bb_engine = false;
+
+static BBlock *bb_table[BB_NR_HASH];
+static BBlock bb_pool[BB_NR_BLOCK];
+static DecodedInstr instr_pool[BB_NR_INSTR];
+static int nr_bb = 0, nr_instr_used = 0;
+#ifdef THREADED_CODE
+static ThreadedOp code_pool[BB_NR_INSTR * TOP_MAX_PER_INSTR];
+static int nr_code_used = 0;
+static const void **top_handler = NULL;
+#endif
+
+/* the block executed last time, or NULL if it is not run to the end */
+static BBlock *prev = NULL;
+
+static uint64_t nr_build = 0, nr_run = 0, nr_chain = 0, nr_flush = 0;
+
+/* instructions done by the running block, which are still known when
+ * a page fault aborts it */
+static uint64_t nr_done = 0;
+
+void exec_once(bool);
+void check_intr(void);
+
+static inline BBlock** bb_slot(vaddr_t eip) {
+  return &bb_table[eip & (BB_NR_HASH - 1)];
+}
+
+static inline bool bb_valid(BBlock *bb) {
+  if (bb->eip != cpu.eip || bb->epoch != icache_epoch || bb->cr3 != icache_cr3()) {
+    return false;
+  }
+  int i;
+  for (i = 0; i < bb->nr_blk; i ++) {
+    if (bb->gen[i] != icache_blk_gen[bb->blk[i]]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void bb_flush(void) {
+  memset(bb_table, 0, sizeof(bb_table));
+  nr_bb = nr_instr_used = 0;
+#ifdef THREADED_CODE
+  nr_code_used = 0;
+#endif
+  prev = NULL;
+  nr_flush ++;
+}
+
+static BBlock* bb_find(void) {
+  if (prev != NULL) {
+    BBlock *bb = prev->succ[cpu.eip != prev->end_eip];
+    if (bb != NULL && bb_valid(bb)) {
+      nr_chain ++;
+      return bb;
+    }
+  }
+
+  BBlock *bb = *bb_slot(cpu.eip);
+  return (bb != NULL && bb_valid(bb) ? bb : NULL);
+}
+
+static inline bool bb_is_end(EHelper execute) {
+  return execute == exec_jmp || execute == exec_jcc || execute == exec_jmp_rm ||
+    execute == exec_call || execute == exec_call_rm || execute == exec_ret ||
+    execute == exec_int || execute == exec_iret ||
+    execute == exec_nemu_trap || execute == exec_inv;
+}
+
+static bool bb_add_blk(BBlock *bb, const ICacheEntry *e) {
+  int i, j;
+  for (i = 0; i < 2; i ++) {
+    for (j = 0; j < bb->nr_blk; j ++) {
+      if (bb->blk[j] == e->blk[i]) break;
+    }
+    if (j < bb->nr_blk) continue;
+    if (bb->nr_blk == BB_MAX_BLK) return false;
+
+    bb->blk[bb->nr_blk] = e->blk[i];
+    bb->gen[bb->nr_blk] = e->gen[i];
+    bb->nr_blk ++;
+  }
+  return true;
+}
+
+#ifdef THREADED_CODE
+static inline int top_form(const Operand *op) {
+  static const int reg_form[] = { [1] = TOP_reg_b, [2] = TOP_reg_w, [4] = TOP_reg_l };
+  static const int mem_form[] = { [1] = TOP_mem_b, [2] = TOP_mem_w, [4] = TOP_mem_l };
+  switch (op->type) {
+    case OP_TYPE_REG: return (op->load_val ? reg_form[op->width] : TOP_copy);
+    case OP_TYPE_MEM: return (op->load_val ? mem_form[op->width] : TOP_mem);
+    case OP_TYPE_CREG: return (op->load_val ? TOP_creg : TOP_copy);
+    default: return TOP_copy;
+  }
+}
+
+static void bb_translate(BBlock *bb) {
+  ThreadedOp *op = bb->code = &code_pool[nr_code_used];
+  int i, j;
+  for (i = 0; i < bb->nr_instr; i ++) {
+    const DecodedInstr *d = &bb->instr[i];
+    const Operand *opnd[] = { &d->src, &d->dest, &d->src2 };
+    /* every operand is copied, since helpers without a decode helper
+     * still read the width of their operands, e.g. movs */
+    for (j = 0; j < 3; j ++) {
+      op->handler = top_handler[j * TOP_NR_FORM + top_form(opnd[j])];
+      op->opnd = opnd[j];
+      op ++;
+    }
+    op->handler = top_handler[TOP_exec];
+    op->instr = d;
+    op ++;
+  }
+  nr_code_used = op - code_pool;
+}
+#endif
+
+static uint64_t bb_run(BBlock *, uint64_t);
+
+/* Execute at most `n' instructions starting at cpu.eip, and record
+ * them as a new block. Return the number of instructions executed.
+ */
+static uint64_t bb_build(uint64_t n, BBlock **pbb) {
+  if (nr_bb == BB_NR_BLOCK || nr_instr_used + BB_MAX_INSTR > BB_NR_INSTR) {
+    bb_flush();
+  }
+
+  BBlock *bb = &bb_pool[nr_bb];
+  bb->eip = cpu.eip;
+  bb->cr3 = icache_cr3();
+  bb->epoch = icache_epoch;
+  bb->nr_blk = 0;
+  bb->nr_instr = 0;
+  bb->instr = &instr_pool[nr_instr_used];
+  bb->succ[0] = bb->succ[1] = NULL;
+
+  uint64_t i;
+  for (i = 0; i < n; ) {
+    vaddr_t eip = cpu.eip;
+    exec_once(false);
+    i ++;
+    nr_done = i;
+    if (nemu_state != NEMU_RUNNING) break;
+
+    /* instructions out of icache can not be recorded */
+    ICacheEntry *e = icache_lookup(eip);
+    if (e == NULL || e->epoch != bb->epoch || !bb_add_blk(bb, e)) break;
+
+    bb->instr[bb->nr_instr ++] = e->instr;
+    bb->end_eip = eip + e->instr.len;
+    if (bb_is_end(e->instr.execute) || bb->nr_instr == BB_MAX_INSTR) break;
+  }
+
+  if (bb->nr_instr > 0) {
+    nr_bb ++;
+    nr_instr_used += bb->nr_instr;
+#ifdef THREADED_CODE
+    if (top_handler == NULL) {
+      bb_run(NULL, 0);
+    }
+    bb_translate(bb);
+#endif
+    *bb_slot(bb->eip) = bb;
+    nr_build ++;
+    *pbb = bb;
+  }
+  else {
+    *pbb = NULL;
+  }
+  return i;
+}
+
+#ifdef THREADED_CODE
+/* operands are copied without their assembly strings */
+#define top_copy(slot) memcpy(&decoding.slot, op->opnd, offsetof(Operand, str))
+
+#define make_top_width_handlers(slot, w, width) \
+  concat3(slot, _reg_, w): \
+    top_copy(slot); \
+    concat(rtl_lr_, w) (&decoding.slot.val, decoding.slot.reg); \
+    op ++; goto *op->handler; \
+  concat3(slot, _mem_, w): \
+    top_copy(slot); \
+    calc_addr(&decoding.slot); \
+    rtl_lm(&decoding.slot.val, &decoding.slot.addr, width); \
+    op ++; goto *op->handler;
+
+#define make_top_handlers(slot) \
+  concat(slot, _copy): \
+    top_copy(slot); \
+    op ++; goto *op->handler; \
+  make_top_width_handlers(slot, b, 1) \
+  make_top_width_handlers(slot, w, 2) \
+  make_top_width_handlers(slot, l, 4) \
+  concat(slot, _mem): \
+    top_copy(slot); \
+    calc_addr(&decoding.slot); \
+    op ++; goto *op->handler; \
+  concat(slot, _creg): \
+    top_copy(slot); \
+    rtl_lcr(&decoding.slot.val, decoding.slot.reg); \
+    op ++; goto *op->handler;
+
+#define top_labels(slot) \
+  &&concat(slot, _copy), \
+  &&concat(slot, _reg_b), &&concat(slot, _reg_w), &&concat(slot, _reg_l), \
+  &&concat(slot, _mem), \
+  &&concat(slot, _mem_b), &&concat(slot, _mem_w), &&concat(slot, _mem_l), \
+  &&concat(slot, _creg)
+
+/* Run the threaded code of `bb'. Calling it with `bb' being NULL
+ * only exports the handlers for translation.
+ */
+static uint64_t bb_run(BBlock *bb, uint64_t n) {
+  static const void *handler[NR_TOP] = {
+    top_labels(src), top_labels(dest), top_labels(src2), &&exec
+  };
+
+  if (bb == NULL) {
+    top_handler = handler;
+    return 0;
+  }
+
+  uint32_t nr_inval = icache_nr_inval;
+  uint64_t i = 0;
+  if (n > bb->nr_instr) {
+    n = bb->nr_instr;
+  }
+
+  const ThreadedOp *op = bb->code;
+  goto *op->handler;
+
+  make_top_handlers(src)
+  make_top_handlers(dest)
+  make_top_handlers(src2)
+
+exec: {
+    const DecodedInstr *d = op->instr;
+#ifdef DIFF_TEST
+    uint32_t eip = cpu.eip;
+#endif
+
+    decoding.opcode = d->opcode;
+    decoding.ext_opcode = d->ext_opcode;
+    decoding.is_operand_size_16 = d->is_operand_size_16;
+    decoding.rep = d->rep;
+    decoding.jmp_eip = d->jmp_eip;
+    decoding.seq_eip = cpu.eip + d->len;
+    d->execute(&decoding.seq_eip);
+    decoding.is_operand_size_16 = false;
+    decoding.rep = REP_NONE;
+    update_eip();
+    i ++;
+    nr_done = i;
+
+#ifdef DIFF_TEST
+    void difftest_step(uint32_t);
+    difftest_step(eip);
+#endif
+
+    /* the rest of the block may have been modified,
+     * or a write trap may have stopped NEMU */
+    if (i == n || icache_nr_inval != nr_inval || nemu_state != NEMU_RUNNING) goto end;
+    op ++; goto *op->handler;
+  }
+
+end:
+  nr_run ++;
+  return i;
+}
+#else
+static uint64_t bb_run(BBlock *bb, uint64_t n) {
+  uint32_t nr_inval = icache_nr_inval;
+  uint64_t i;
+  if (n > bb->nr_instr) {
+    n = bb->nr_instr;
+  }
+
+  for (i = 0; i < n; ) {
+#ifdef DIFF_TEST
+    uint32_t eip = cpu.eip;
+#endif
+
+    decoding.seq_eip = cpu.eip;
+    exec_decoded(&bb->instr[i], &decoding.seq_eip);
+    update_eip();
+    i ++;
+    nr_done = i;
+
+#ifdef DIFF_TEST
+    void difftest_step(uint32_t);
+    difftest_step(eip);
+#endif
+
+    /* the rest of the block may have been modified,
+     * or a write trap may have stopped NEMU */
+    if (icache_nr_inval != nr_inval || nemu_state != NEMU_RUNNING) break;
+  }
+
+  nr_run ++;
+  return i;
+}
+#endif
+
+/* Execute the block at cpu.eip, but no more than `n' instructions.
+ * Return the number of instructions executed.
+ */
+uint64_t bb_exec(uint64_t n) {
+  nr_done = 0;
+  BBlock *bb = bb_find();
+  uint64_t nr_exec;
+  if (bb != NULL) {
+    nr_exec = bb_run(bb, n);
+  }
+  else {
+    nr_exec = bb_build(n, &bb);
+  }
+
+  if (bb != NULL && nr_exec == bb->nr_instr) {
+    if (prev != NULL) {
+      prev->succ[bb->eip != prev->end_eip] = bb;
+    }
+    prev = bb;
+  }
+  else {
+    prev = NULL;
+  }
+
+  check_intr();
+  return nr_exec;
+}
+
+/* The running block is aborted by a page fault. Return the number of
+ * instructions it has done. */
+uint64_t bb_abort(void) {
+  prev = NULL;
+  return nr_done;
+}
+
+void bb_report(void) {
+  if (!bb_engine) return;
+  Log("bb: %" PRIu64 " blocks built, %" PRIu64 " runs, %" PRIu64 " chained, %" PRIu64 " flushes",
+      nr_build, nr_run, nr_chain, nr_flush);
+}
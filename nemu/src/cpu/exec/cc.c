@@ -1,15 +1,97 @@
 #include "cpu/rtl.h"
 
+LazyEflags lazy_eflags;
+
+/* Compute the flags from the last recorded operation. */
+void lazy_eflags_eval(void) {
+  LazyEflags *l = &lazy_eflags;
+  int sign_bit = l->width * 8 - 1;
+  uint32_t mask = ~0u >> ((4 - l->width) * 8);
+  uint32_t d = l->dest & mask, s = l->src & mask, r = l->result & mask;
+
+  switch (l->op) {
+    case LAZY_NONE: return;
+    case LAZY_ADD:
+      cpu.CF = (r < d);
+      cpu.OF = ((~(d ^ s) & (d ^ r)) >> sign_bit) & 0x1;
+      break;
+    case LAZY_ADC:
+      cpu.CF = (r < d || (cpu.CF && r == d));
+      cpu.OF = ((~(d ^ s) & (d ^ r)) >> sign_bit) & 0x1;
+      break;
+    case LAZY_SUB:
+      cpu.CF = (d < s);
+      cpu.OF = (((d ^ s) & (d ^ r)) >> sign_bit) & 0x1;
+      break;
+    case LAZY_SBB:
+      cpu.CF = (d < s || (cpu.CF && d == s));
+      cpu.OF = (((d ^ s) & (d ^ r)) >> sign_bit) & 0x1;
+      break;
+    case LAZY_INC:
+      cpu.OF = ((~d & r) >> sign_bit) & 0x1;
+      break;
+    case LAZY_DEC:
+      cpu.OF = ((d & ~r) >> sign_bit) & 0x1;
+      break;
+    case LAZY_LOGIC:
+      cpu.CF = cpu.OF = 0;
+      break;
+    default: panic("should not reach here");
+  }
+  cpu.ZF = (r == 0);
+  cpu.SF = (r >> sign_bit) & 0x1;
+  l->op = LAZY_NONE;
+}
+
 /* Condition Code */
 
+enum {
+  CC_O, CC_NO, CC_B,  CC_NB,
+  CC_E, CC_NE, CC_BE, CC_NBE,
+  CC_S, CC_NS, CC_P,  CC_NP,
+  CC_L, CC_NL, CC_LE, CC_NLE
+};
+
+/* Evaluate the condition directly from a pending cmp/sub or test/logic
+ * operation, without computing the flags. Return false for other cases.
+ */
+static inline bool lazy_setcc(rtlreg_t* dest, uint8_t cc) {
+  LazyEflags *l = &lazy_eflags;
+  int shift = (4 - l->width) * 8;
+  uint32_t d = l->dest << shift, s = l->src << shift, r = l->result << shift;
+
+  if (l->op == LAZY_SUB) {
+    switch (cc) {
+      case CC_B:  *dest = (d < s); return true;
+      case CC_E:  *dest = (d == s); return true;
+      case CC_BE: *dest = (d <= s); return true;
+      case CC_S:  *dest = (r >> 31); return true;
+      case CC_L:  *dest = ((int32_t)d < (int32_t)s); return true;
+      case CC_LE: *dest = ((int32_t)d <= (int32_t)s); return true;
+      default: return false;
+    }
+  }
+  if (l->op == LAZY_LOGIC) {
+    switch (cc) {
+      case CC_O: case CC_B: *dest = 0; return true;
+      case CC_E: case CC_BE: *dest = (r == 0); return true;
+      case CC_S: case CC_L: *dest = (r >> 31); return true;
+      case CC_LE: *dest = (r == 0 || (r >> 31)); return true;
+      default: return false;
+    }
+  }
+  return false;
+}
+
 void rtl_setcc(rtlreg_t* dest, uint8_t subcode) {
   bool invert = subcode & 0x1;
-  enum {
-    CC_O, CC_NO, CC_B,  CC_NB,
-    CC_E, CC_NE, CC_BE, CC_NBE,
-    CC_S, CC_NS, CC_P,  CC_NP,
-    CC_L, CC_NL, CC_LE, CC_NLE
-  };
+
+  if (lazy_setcc(dest, subcode & 0xe)) {
+    if (invert) {
+      rtl_xori(dest, dest, 0x1);
+    }
+    return;
+  }
 
   // Query EFLAGS to determine whether the condition code is satisfied.
   // dest <- ( cc is satisfied ? 1 : 0)
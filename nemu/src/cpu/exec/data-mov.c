@@ -14,37 +14,51 @@ make_EHelper(push) {
 
 // 32bit only
 make_EHelper(pop) {
-  rtl_pop(&t0);
-  operand_write(id_dest, &t0);
+  if (id_dest->type == OP_TYPE_MEM) {
+    // esp is kept if the write causes a page fault
+    rtl_lm(&t0, &reg_l(R_ESP), 4);
+    operand_write(id_dest, &t0);
+    rtl_addi(&reg_l(R_ESP), &reg_l(R_ESP), 4);
+  }
+  else {
+    // `pop %esp' loads esp at last
+    rtl_pop(&t0);
+    operand_write(id_dest, &t0);
+  }
 
   print_asm_template1(pop);
 }
 
+/* The registers are stored from eax at esp - 4 down to edi at esp - 32,
+ * which is the order of R_EAX to R_EDI. pusha and popa access all of
+ * the stack before updating any register, so that they can be done
+ * again after a page fault. */
+
 // 32bit only
 make_EHelper(pusha) {
-  rtl_lr_l(&t0, R_ESP);
-  rtl_push(&reg_l(R_EAX));
-  rtl_push(&reg_l(R_ECX));
-  rtl_push(&reg_l(R_EDX));
-  rtl_push(&reg_l(R_EBX));
-  rtl_push(&t0);
-  rtl_push(&reg_l(R_EBP));
-  rtl_push(&reg_l(R_ESI));
-  rtl_push(&reg_l(R_EDI));
+  int i;
+  for (i = R_EAX; i <= R_EDI; i ++) {
+    rtl_subi(&t0, &reg_l(R_ESP), 4 * (i + 1));
+    rtl_sm(&t0, 4, &reg_l(i));
+  }
+  rtl_subi(&reg_l(R_ESP), &reg_l(R_ESP), 32);
   
   print_asm("pusha");
 }
 
 // 32bit only
 make_EHelper(popa) {
-  rtl_pop(&reg_l(R_EDI));
-  rtl_pop(&reg_l(R_ESI));
-  rtl_pop(&reg_l(R_EBP));
-  rtl_pop(&t0);
-  rtl_pop(&reg_l(R_EBX));
-  rtl_pop(&reg_l(R_EDX));
-  rtl_pop(&reg_l(R_ECX));
-  rtl_pop(&reg_l(R_EAX));
+  rtlreg_t val[8];
+  int i;
+  for (i = R_EAX; i <= R_EDI; i ++) {
+    rtl_addi(&t0, &reg_l(R_ESP), 28 - 4 * i);
+    rtl_lm(&val[i], &t0, 4);
+  }
+  // the value of esp is skipped
+  for (i = R_EAX; i <= R_EDI; i ++) {
+    if (i != R_ESP) rtl_mv(&reg_l(i), &val[i]);
+  }
+  rtl_addi(&reg_l(R_ESP), &reg_l(R_ESP), 32);
   
   print_asm("popa");
 }
@@ -82,14 +96,12 @@ make_EHelper(cwtl) {
 }
 
 make_EHelper(movsx) {
-  id_dest->width = decoding.is_operand_size_16 ? 2 : 4;
   rtl_sext(&t2, &id_src->val, id_src->width);
   operand_write(id_dest, &t2);
   print_asm_template2(movsx);
 }
 
 make_EHelper(movzx) {
-  id_dest->width = decoding.is_operand_size_16 ? 2 : 4;
   operand_write(id_dest, &id_src->val);
   print_asm_template2(movzx);
 }
@@ -1,20 +1,23 @@
 #include "cpu/exec.h"
+#include "cpu/icache.h"
+#include "monitor/prof.h"
+#include "monitor/itrace.h"
 #include "all-instr.h"
+#include "device/intr.h"
 
 typedef struct {
   DHelper decode;
   EHelper execute;
   int width;
+  const char *name;
 } opcode_entry;
 
-#define IDEXW(id, ex, w)   {concat(decode_, id), concat(exec_, ex), w}
+#define IDEXW(id, ex, w)   {concat(decode_, id), concat(exec_, ex), w, str(ex)}
 #define IDEX(id, ex)       IDEXW(id, ex, 0)
-#define EXW(ex, w)         {NULL, concat(exec_, ex), w}
+#define EXW(ex, w)         {NULL, concat(exec_, ex), w, str(ex)}
 #define EX(ex)             EXW(ex, 0)
 #define EMPTY              EX(inv)
 
-#define TIMER_IRQ 32
-
 static inline void set_width(int width) {
   if (width == 0) {
     width = decoding.is_operand_size_16 ? 2 : 4;
@@ -22,11 +25,22 @@ static inline void set_width(int width) {
   decoding.src.width = decoding.dest.width = decoding.src2.width = width;
 }
 
+/* Operands left untouched by the decode helper should
+ * not be reloaded when the decoding result is reused.
+ */
+static inline void reset_operands(void) {
+  decoding.src.type = decoding.dest.type = decoding.src2.type = OP_TYPE_NONE;
+}
+
+void icache_fill(EHelper, const char *, vaddr_t);
+bool icache_exec(vaddr_t *);
+
 /* Instruction Decode and EXecute */
 static inline void idex(vaddr_t *eip, opcode_entry *e) {
   /* eip is pointing to the byte next to opcode */
   if (e->decode)
     e->decode(eip);
+  icache_fill(e->execute, e->name, *eip);
   e->execute(eip);
 }
 
@@ -69,7 +83,7 @@ make_group(gp5,
   /* 0x0f 0x01*/
 make_group(gp7,
     EMPTY, EMPTY, EMPTY, EX(lidt),
-    EMPTY, EMPTY, EMPTY, EMPTY)
+    EMPTY, EMPTY, EMPTY, EX(invlpg))
 
 opcode_entry opcode_table [512] = {
   /* 0x00 */	IDEXW(G2E, add, 1), IDEX(G2E, add), IDEXW(E2G, add, 1), IDEX(E2G, add),
@@ -113,9 +127,9 @@ opcode_entry opcode_table [512] = {
   /* 0x98 */	EX(cwtl), EX(cltd), EMPTY, EMPTY,
   /* 0x9c */	EMPTY, EMPTY, EMPTY, EMPTY,
   /* 0xa0 */	IDEXW(O2a, mov, 1), IDEX(O2a, mov), IDEXW(a2O, mov, 1), IDEX(a2O, mov),
-  /* 0xa4 */	EMPTY, EMPTY, EMPTY, EMPTY,
-  /* 0xa8 */	IDEXW(I2a, test, 1), IDEX(I2a, test), EMPTY, EMPTY,
-  /* 0xac */	EMPTY, EMPTY, EMPTY, EMPTY,
+  /* 0xa4 */	EXW(movs, 1), EX(movs), EXW(cmps, 1), EX(cmps),
+  /* 0xa8 */	IDEXW(I2a, test, 1), IDEX(I2a, test), EXW(stos, 1), EX(stos),
+  /* 0xac */	EXW(lods, 1), EX(lods), EXW(scas, 1), EX(scas),
   /* 0xb0 */	IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1),
   /* 0xb4 */	IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1), IDEXW(mov_I2r, mov, 1),
   /* 0xb8 */	IDEX(mov_I2r, mov), IDEX(mov_I2r, mov), IDEX(mov_I2r, mov), IDEX(mov_I2r, mov),
@@ -132,10 +146,10 @@ opcode_entry opcode_table [512] = {
   /* 0xe4 */	IDEXW(in_I2a, in, 1), IDEX(in_I2a, in), IDEXW(out_a2I, out, 1), IDEX(out_a2I, out),
   /* 0xe8 */	IDEX(J, call), IDEX(J, jmp), EMPTY, IDEXW(J, jmp, 1),
   /* 0xec */	IDEXW(in_dx2a, in, 1), IDEX(in_dx2a, in), IDEXW(out_a2dx, out, 1), IDEX(out_a2dx, out),
-  /* 0xf0 */	EMPTY, EMPTY, EMPTY, EMPTY,
+  /* 0xf0 */	EMPTY, EMPTY, EX(repne), EX(rep),
   /* 0xf4 */	EMPTY, EMPTY, IDEXW(E, gp3, 1), IDEX(E, gp3),
   /* 0xf8 */	EMPTY, EMPTY, EMPTY, EMPTY,
-  /* 0xfc */	EMPTY, EMPTY, IDEXW(E, gp4, 1), IDEX(E, gp5),
+  /* 0xfc */	EX(cld), EX(std), IDEXW(E, gp4, 1), IDEX(E, gp5),
 
   /*2 byte_opcode_table */
 
@@ -184,9 +198,9 @@ opcode_entry opcode_table [512] = {
   /* 0xa8 */	EMPTY, EMPTY, EMPTY, EMPTY,
   /* 0xac */	EMPTY, EMPTY, EMPTY, IDEX(E2G, imul2),
   /* 0xb0 */	EMPTY, EMPTY, EMPTY, EMPTY,
-  /* 0xb4 */	EMPTY, EMPTY, IDEXW(mov_E2G, movzx, 1), IDEXW(mov_E2G, movzx, 2),
+  /* 0xb4 */	EMPTY, EMPTY, IDEXW(movx_E2G, movzx, 1), IDEXW(movx_E2G, movzx, 2),
   /* 0xb8 */	EMPTY, EMPTY, EMPTY, EMPTY,
-  /* 0xbc */	EMPTY, EMPTY, IDEXW(mov_E2G, movsx, 1), IDEXW(mov_E2G, movsx, 2),
+  /* 0xbc */	EMPTY, EMPTY, IDEXW(movx_E2G, movsx, 1), IDEXW(movx_E2G, movsx, 2),
   /* 0xc0 */	EMPTY, EMPTY, EMPTY, EMPTY,
   /* 0xc4 */	EMPTY, EMPTY, EMPTY, EMPTY,
   /* 0xc8 */	EMPTY, EMPTY, EMPTY, EMPTY,
@@ -209,6 +223,7 @@ static make_EHelper(2byte_esc) {
   uint32_t opcode = instr_fetch(eip, 1) | 0x100;
   decoding.opcode = opcode;
   set_width(opcode_table[opcode].width);
+  reset_operands();
   idex(eip, &opcode_table[opcode]);
 }
 
@@ -216,32 +231,45 @@ make_EHelper(real) {
   uint32_t opcode = instr_fetch(eip, 1);
   decoding.opcode = opcode;
   set_width(opcode_table[opcode].width);
+  reset_operands();
   idex(eip, &opcode_table[opcode]);
 }
 
-static inline void update_eip(void) {
-  cpu.eip = (decoding.is_jmp ? (decoding.is_jmp = 0, decoding.jmp_eip) : decoding.seq_eip);
-}
-
 void raise_intr(uint8_t NO, vaddr_t ret_addr);
 
-void exec_wrapper(bool print_flag) {
-#ifdef DEBUG
+/* Execute the instruction at cpu.eip without checking interrupts. */
+void exec_once(bool print_flag) {
+#ifdef DISASM_LOG
   decoding.p = decoding.asm_buf;
   decoding.p += sprintf(decoding.p, "%8x:   ", cpu.eip);
 #endif
 
   decoding.seq_eip = cpu.eip;
-  exec_real(&decoding.seq_eip);
+  if (!icache_exec(&decoding.seq_eip)) {
+    decoding.instr = decoding.instr_buf;
+    exec_real(&decoding.seq_eip);
+  }
+
+  if (prof_enable) {
+    prof_record(cpu.eip, decoding.opcode);
+  }
 
-#ifdef DEBUG
   int instr_len = decoding.seq_eip - cpu.eip;
+  if (itrace_enable) {
+    itrace_record(cpu.eip, instr_len, decoding.instr);
+  }
+
+#ifdef DISASM_LOG
   sprintf(decoding.p, "%*.s", 50 - (12 + 3 * instr_len), "");
   strcat(decoding.asm_buf, decoding.assembly);
   Log_write("%s\n", decoding.asm_buf);
   if (print_flag) {
     puts(decoding.asm_buf);
   }
+#else
+  if (print_flag) {
+    itrace_print(cpu.eip, instr_len, decoding.instr);
+  }
 #endif
 
 
@@ -255,10 +283,16 @@ void exec_wrapper(bool print_flag) {
   void difftest_step(uint32_t);
   difftest_step(eip);
 #endif
+}
 
+void check_intr(void) {
   if (cpu.INTR & cpu.IF) {
-    cpu.INTR = false;
-    raise_intr(TIMER_IRQ, cpu.eip);
+    raise_intr(intr_ack(), cpu.eip);
     update_eip();
   }
 }
+
+void exec_wrapper(bool print_flag) {
+  exec_once(print_flag);
+  check_intr();
+}
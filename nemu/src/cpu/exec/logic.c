@@ -3,9 +3,7 @@
 make_EHelper(test) {
   rtl_and(&t0, &id_dest->val, &id_src->val);
   
-  rtl_set_CF(&tzero);
-  rtl_set_OF(&tzero);
-  rtl_update_ZFSF(&t0, id_dest->width);
+  rtl_update_eflags(LAZY_LOGIC, &id_dest->val, &id_src->val, &t0, id_dest->width);
 
   print_asm_template2(test);
 }
@@ -14,9 +12,7 @@ make_EHelper(and) {
   rtl_and(&t0, &id_dest->val, &id_src->val);
   operand_write(id_dest, &t0);
 
-  rtl_set_CF(&tzero);
-  rtl_set_OF(&tzero);
-  rtl_update_ZFSF(&t0, id_dest->width);
+  rtl_update_eflags(LAZY_LOGIC, &id_dest->val, &id_src->val, &t0, id_dest->width);
   
   print_asm_template2(and);
 }
@@ -25,9 +21,7 @@ make_EHelper(xor) {
   rtl_xor(&t0, &id_dest->val, &id_src->val);
   operand_write(id_dest, &t0);
   
-  rtl_set_CF(&tzero);
-  rtl_set_OF(&tzero);
-  rtl_update_ZFSF(&t0, id_dest->width);
+  rtl_update_eflags(LAZY_LOGIC, &id_dest->val, &id_src->val, &t0, id_dest->width);
   print_asm_template2(xor);
 }
 
@@ -35,9 +29,7 @@ make_EHelper(or) {
   rtl_or(&t0, &id_dest->val, &id_src->val);
   operand_write(id_dest, &t0);
   
-  rtl_set_CF(&tzero);
-  rtl_set_OF(&tzero);
-  rtl_update_ZFSF(&t0, id_dest->width);
+  rtl_update_eflags(LAZY_LOGIC, &id_dest->val, &id_src->val, &t0, id_dest->width);
 
   print_asm_template2(or);
 }
@@ -7,3 +7,16 @@ make_EHelper(operand_size) {
   exec_real(eip);
   decoding.is_operand_size_16 = false;
 }
+
+/* 0xf3 is rep for movs, stos and lods, and repe for cmps and scas */
+make_EHelper(rep) {
+  decoding.rep = REP_E;
+  exec_real(eip);
+  decoding.rep = REP_NONE;
+}
+
+make_EHelper(repne) {
+  decoding.rep = REP_NE;
+  exec_real(eip);
+  decoding.rep = REP_NONE;
+}
@@ -1,5 +1,6 @@
 #include "cpu/exec.h"
 #include "monitor/monitor.h"
+#include "monitor/itrace.h"
 
 make_EHelper(nop) {
   print_asm("nop");
@@ -27,6 +28,10 @@ make_EHelper(inv) {
       "* The machine is always right!\n"
       "* Every line of untested code is always wrong!\33[0m\n\n", logo);
 
+  if (itrace_enable) {
+    itrace_dump(ITRACE_DUMP_DEFAULT);
+  }
+
   nemu_state = NEMU_END;
 
   print_asm("invalid opcode");
@@ -0,0 +1,282 @@
+#include "cpu/exec.h"
+#include "memory/mmu.h"
+#include "monitor/monitor.h"
+
+/* String instructions. Addresses are always 32-bit, and the segment
+ * registers are ignored as elsewhere in NEMU. With a rep prefix the
+ * whole loop is one instruction. When DF is clear, the elements within
+ * a page are accessed at once through the host memory if possible.
+ */
+
+static inline int str_step(int width) {
+  return cpu.DF ? -width : width;
+}
+
+/* The number of bytes of a bulk access from `addr', which is bounded
+ * by the end of its page and `n' elements of `width' bytes. */
+static inline uint32_t str_span(vaddr_t addr, uint32_t n, int width) {
+  uint32_t left = PAGE_SIZE - (addr & PAGE_MASK);
+  uint64_t total = (uint64_t)n * width;
+  return (total < left ? total : left / width * width);
+}
+
+/* QEMU steps a rep instruction one element at a time, so differential
+ * testing is told how many elements are done since `ecx'. */
+static inline void str_rep_done(uint32_t ecx) {
+#ifdef DIFF_TEST
+  void diff_test_rep(uint32_t);
+  if (decoding.rep != REP_NONE) { diff_test_rep(ecx - cpu.ecx); }
+#endif
+}
+
+static inline uint32_t host_load(const uint8_t *p, int width) {
+  uint32_t val = 0;
+  memcpy(&val, p, width);
+  return val;
+}
+
+/* A rep loop is stopped if a write trap is hit. eip is kept at the
+ * instruction, and the loop goes on from ecx when NEMU continues. */
+static inline bool str_is_stopped(vaddr_t *eip) {
+  if (nemu_state != NEMU_RUNNING && cpu.ecx != 0) {
+    *eip = cpu.eip;
+    return true;
+  }
+  return false;
+}
+
+static inline void movs_once(int width) {
+  rtl_lm(&t0, &cpu.esi, width);
+  rtl_sm(&cpu.edi, width, &t0);
+  cpu.esi += str_step(width);
+  cpu.edi += str_step(width);
+}
+
+/* Return the number of elements moved, or 0 if the bulk move is not
+ * possible, e.g. the pages are not RAM, or the destination overlaps the
+ * source ahead of it, where elements should be copied one by one. */
+static inline uint32_t movs_bulk(int width) {
+  uint32_t len = str_span(cpu.esi, cpu.ecx, width);
+  uint32_t len_dst = str_span(cpu.edi, cpu.ecx, width);
+  if (len_dst < len) len = len_dst;
+  if (len == 0) return 0;
+
+  uint8_t *src = vaddr_host(cpu.esi, len, false);
+  if (src == NULL) return 0;
+  uint8_t *dst = vaddr_host(cpu.edi, len, true);
+  if (dst == NULL || (dst > src && dst < src + len)) return 0;
+
+  memmove(dst, src, len);
+  cpu.esi += len;
+  cpu.edi += len;
+  return len / width;
+}
+
+make_EHelper(movs) {
+  int width = id_dest->width;
+  uint32_t ecx = cpu.ecx;
+  if (decoding.rep == REP_NONE) {
+    movs_once(width);
+  }
+  else {
+    while (cpu.ecx != 0) {
+      uint32_t n = (cpu.DF ? 0 : movs_bulk(width));
+      if (n == 0) {
+        movs_once(width);
+        n = 1;
+      }
+      cpu.ecx -= n;
+      if (str_is_stopped(eip)) break;
+    }
+  }
+
+  str_rep_done(ecx);
+
+  print_asm("%smovs%c", (decoding.rep != REP_NONE ? "rep " : ""), suffix_char(width));
+}
+
+static inline void stos_once(int width) {
+  rtl_lr(&t0, R_EAX, width);
+  rtl_sm(&cpu.edi, width, &t0);
+  cpu.edi += str_step(width);
+}
+
+static inline uint32_t stos_bulk(int width) {
+  uint32_t len = str_span(cpu.edi, cpu.ecx, width);
+  if (len == 0) return 0;
+  uint8_t *dst = vaddr_host(cpu.edi, len, true);
+  if (dst == NULL) return 0;
+
+  uint32_t val = cpu.eax;
+  if (((((val & 0xff) * 0x01010101u) ^ val) & (~0u >> ((4 - width) << 3))) == 0) {
+    /* all bytes of the element are the same */
+    memset(dst, val & 0xff, len);
+  }
+  else {
+    uint32_t i;
+    for (i = 0; i < len; i += width) {
+      memcpy(dst + i, &val, width);
+    }
+  }
+  cpu.edi += len;
+  return len / width;
+}
+
+make_EHelper(stos) {
+  int width = id_dest->width;
+  uint32_t ecx = cpu.ecx;
+  if (decoding.rep == REP_NONE) {
+    stos_once(width);
+  }
+  else {
+    while (cpu.ecx != 0) {
+      uint32_t n = (cpu.DF ? 0 : stos_bulk(width));
+      if (n == 0) {
+        stos_once(width);
+        n = 1;
+      }
+      cpu.ecx -= n;
+      if (str_is_stopped(eip)) break;
+    }
+  }
+
+  str_rep_done(ecx);
+
+  print_asm("%sstos%c", (decoding.rep != REP_NONE ? "rep " : ""), suffix_char(width));
+}
+
+make_EHelper(lods) {
+  int width = id_dest->width;
+  uint32_t ecx = cpu.ecx;
+  bool is_rep = (decoding.rep != REP_NONE);
+  if (!is_rep || cpu.ecx != 0) {
+    do {
+      rtl_lm(&t0, &cpu.esi, width);
+      rtl_sr(R_EAX, width, &t0);
+      cpu.esi += str_step(width);
+    } while (is_rep && -- cpu.ecx != 0);
+  }
+
+  str_rep_done(ecx);
+
+  print_asm("%slods%c", (is_rep ? "rep " : ""), suffix_char(width));
+}
+
+/* Whether a repe/repne loop should stop after comparing `a' with `b'. */
+static inline bool str_cmp_stop(uint32_t a, uint32_t b) {
+  return (decoding.rep == REP_E ? a != b : a == b);
+}
+
+/* Compare the elements at `a' and `b' in the host memory until the rep
+ * condition fails or `n' elements are compared. `a' is not advanced if
+ * `a_step' is 0. Return the number of elements compared, and the last
+ * pair of them in `*va' and `*vb'. */
+static inline uint32_t cmp_bulk(const uint8_t *a, int a_step, const uint8_t *b,
+    uint32_t n, int width, uint32_t *va, uint32_t *vb) {
+  uint32_t i;
+  for (i = 0; i < n; ) {
+    *va = host_load(a + i * a_step, width);
+    *vb = host_load(b + i * width, width);
+    i ++;
+    if (str_cmp_stop(*va, *vb)) break;
+  }
+  return i;
+}
+
+static inline void str_cmp_eflags(uint32_t a, uint32_t b, int width) {
+  t0 = a;
+  t1 = b;
+  rtl_sub(&t2, &t0, &t1);
+  rtl_update_eflags(LAZY_SUB, &t0, &t1, &t2, width);
+}
+
+make_EHelper(cmps) {
+  int width = id_dest->width;
+  uint32_t ecx = cpu.ecx;
+  uint32_t a = 0, b = 0;
+  if (decoding.rep == REP_NONE) {
+    rtl_lm(&a, &cpu.esi, width);
+    rtl_lm(&b, &cpu.edi, width);
+    str_cmp_eflags(a, b, width);
+    cpu.esi += str_step(width);
+    cpu.edi += str_step(width);
+  }
+  else if (cpu.ecx != 0) {
+    while (cpu.ecx != 0) {
+      uint32_t n = 0;
+      if (!cpu.DF) {
+        uint32_t len = str_span(cpu.esi, cpu.ecx, width);
+        uint32_t len_b = str_span(cpu.edi, cpu.ecx, width);
+        if (len_b < len) len = len_b;
+        const uint8_t *pa = (len == 0 ? NULL : vaddr_host(cpu.esi, len, false));
+        const uint8_t *pb = (pa == NULL ? NULL : vaddr_host(cpu.edi, len, false));
+        if (pb != NULL) {
+          n = cmp_bulk(pa, width, pb, len / width, width, &a, &b);
+        }
+      }
+      if (n == 0) {
+        rtl_lm(&a, &cpu.esi, width);
+        rtl_lm(&b, &cpu.edi, width);
+        n = 1;
+      }
+      cpu.esi += n * str_step(width);
+      cpu.edi += n * str_step(width);
+      cpu.ecx -= n;
+      if (str_cmp_stop(a, b)) break;
+    }
+    str_cmp_eflags(a, b, width);
+  }
+
+  str_rep_done(ecx);
+
+  print_asm("%scmps%c", (decoding.rep == REP_E ? "repe " : (decoding.rep == REP_NE ? "repne " : "")),
+      suffix_char(width));
+}
+
+make_EHelper(scas) {
+  int width = id_dest->width;
+  uint32_t ecx = cpu.ecx;
+  uint32_t a = 0, b = 0;
+  rtl_lr(&a, R_EAX, width);
+  if (decoding.rep == REP_NONE) {
+    rtl_lm(&b, &cpu.edi, width);
+    str_cmp_eflags(a, b, width);
+    cpu.edi += str_step(width);
+  }
+  else if (cpu.ecx != 0) {
+    uint32_t eax = a;
+    while (cpu.ecx != 0) {
+      uint32_t n = 0;
+      if (!cpu.DF) {
+        uint32_t len = str_span(cpu.edi, cpu.ecx, width);
+        const uint8_t *pb = (len == 0 ? NULL : vaddr_host(cpu.edi, len, false));
+        if (pb != NULL) {
+          n = cmp_bulk((const uint8_t *)&eax, 0, pb, len / width, width, &a, &b);
+        }
+      }
+      if (n == 0) {
+        rtl_lm(&b, &cpu.edi, width);
+        n = 1;
+      }
+      cpu.edi += n * str_step(width);
+      cpu.ecx -= n;
+      if (str_cmp_stop(a, b)) break;
+    }
+    str_cmp_eflags(a, b, width);
+  }
+
+  str_rep_done(ecx);
+
+  print_asm("%sscas%c", (decoding.rep == REP_E ? "repe " : (decoding.rep == REP_NE ? "repne " : "")),
+      suffix_char(width));
+}
+
+make_EHelper(cld) {
+  cpu.DF = 0;
+  print_asm("cld");
+}
+
+make_EHelper(std) {
+  cpu.DF = 1;
+  print_asm("std");
+}
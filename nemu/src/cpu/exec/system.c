@@ -16,6 +16,15 @@ make_EHelper(lidt) {
   print_asm_template1(lidt);
 }
 
+/* Decoded instructions are found by their virtual addresses, so they
+ * are also dropped when a page is remapped. */
+make_EHelper(invlpg) {
+  tlb_invalidate(id_dest->addr);
+  icache_flush();
+
+  print_asm("invlpg %s", id_dest->str);
+}
+
 make_EHelper(mov_r2cr) {
   TODO();
 
@@ -43,10 +52,17 @@ make_EHelper(int) {
 }
 
 make_EHelper(iret) {
+  // all of the stack is read before updating any register,
+  // so that esp is kept if a read causes a page fault
+  rtl_addi(&t0, &reg_l(R_ESP), 4);
+  rtl_lm(&t1, &t0, 4);
+  rtl_addi(&t0, &reg_l(R_ESP), 8);
+  rtl_lm(&t2, &t0, 4);
   rtl_pop(&decoding.jmp_eip);
   decoding.is_jmp = 1;
-  rtl_pop(&cpu.cs);
-  rtl_pop(&cpu.eflags);
+  rtl_addi(&reg_l(R_ESP), &reg_l(R_ESP), 8);
+  rtl_mv(&cpu.cs, &t1);
+  rtl_set_eflags(&t2);
 
   print_asm("iret");
 }
@@ -68,7 +84,7 @@ make_EHelper(in) {
 make_EHelper(out) {
   pio_write(id_dest->val, id_src->width, id_src->val);
 
-  print_asm_template2(out);
+  print_asm("out%c %s,%s", suffix_char(id_src->width), id_src->str, id_dest->str);
 
 #ifdef DIFF_TEST
   diff_test_skip_qemu();
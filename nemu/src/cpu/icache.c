@@ -0,0 +1,138 @@
+#include "cpu/exec.h"
+#include "cpu/icache.h"
+#include <inttypes.h>
+
+static ICacheEntry icache[ICACHE_NR_ENTRY];
+
+uint8_t icache_blk_has_code[ICACHE_NR_BLK];
+uint32_t icache_blk_gen[ICACHE_NR_BLK];
+
+/* entries filled before the last flush are dead */
+uint32_t icache_epoch = 1;
+
+/* bumped whenever some entries become invalid */
+uint32_t icache_nr_inval = 0;
+
+static uint64_t nr_hit = 0, nr_miss = 0;
+
+static inline ICacheEntry* icache_entry(vaddr_t eip) {
+  return &icache[eip & (ICACHE_NR_ENTRY - 1)];
+}
+
+/* Record the decoding result of the instruction starting at cpu.eip.
+ * It is called after decoding and before execution. For the group
+ * and prefix helpers, the record made by the inner opcode entry
+ * overwrites the outer one.
+ */
+void icache_fill(EHelper execute, const char *name, vaddr_t eip_end) {
+  vaddr_t eip = cpu.eip;
+  paddr_t paddr_begin = page_translate(eip);
+  paddr_t paddr_end = page_translate(eip_end - 1);
+  if (paddr_begin >= pmem_size || paddr_end >= pmem_size) {
+    return;
+  }
+
+  ICacheEntry *e = icache_entry(eip);
+  e->eip = eip;
+  e->cr3 = icache_cr3();
+  e->epoch = icache_epoch;
+
+  int i;
+  e->blk[0] = paddr_begin >> ICACHE_BLK_SHIFT;
+  e->blk[1] = paddr_end >> ICACHE_BLK_SHIFT;
+  for (i = 0; i < 2; i ++) {
+    e->gen[i] = icache_blk_gen[e->blk[i]];
+    icache_blk_has_code[e->blk[i]] = true;
+  }
+
+  memcpy(e->instr_bytes, decoding.instr_buf, sizeof(e->instr_bytes));
+
+  DecodedInstr *d = &e->instr;
+  d->opcode = decoding.opcode;
+  d->ext_opcode = decoding.ext_opcode;
+  d->is_operand_size_16 = decoding.is_operand_size_16;
+  d->rep = decoding.rep;
+  d->len = eip_end - eip;
+  d->jmp_eip = decoding.jmp_eip;
+  d->execute = execute;
+  d->name = name;
+  d->src = decoding.src;
+  d->dest = decoding.dest;
+  d->src2 = decoding.src2;
+}
+
+/* Return the valid entry for the instruction at `eip', or NULL. */
+ICacheEntry* icache_lookup(vaddr_t eip) {
+  ICacheEntry *e = icache_entry(eip);
+  if (e->eip != eip || e->epoch != icache_epoch || e->cr3 != icache_cr3() ||
+      e->gen[0] != icache_blk_gen[e->blk[0]] || e->gen[1] != icache_blk_gen[e->blk[1]]) {
+    return NULL;
+  }
+  return e;
+}
+
+/* Execute an instruction with its decoding result. `*eip' should
+ * point to the beginning of the instruction. */
+void exec_decoded(const DecodedInstr *d, vaddr_t *eip) {
+  decoding.opcode = d->opcode;
+  decoding.ext_opcode = d->ext_opcode;
+  decoding.is_operand_size_16 = d->is_operand_size_16;
+  decoding.rep = d->rep;
+  decoding.jmp_eip = d->jmp_eip;
+  decoding.src = d->src;
+  decoding.dest = d->dest;
+  decoding.src2 = d->src2;
+  operand_reload(id_src);
+  operand_reload(id_dest);
+  operand_reload(id_src2);
+
+  *eip += d->len;
+  d->execute(eip);
+  decoding.is_operand_size_16 = false;
+  decoding.rep = REP_NONE;
+}
+
+/* Execute the instruction at `*eip' with the cached decoding result.
+ * Return false if it is not in the cache.
+ */
+bool icache_exec(vaddr_t *eip) {
+  ICacheEntry *e = icache_lookup(*eip);
+  if (e == NULL) {
+    nr_miss ++;
+    return false;
+  }
+  nr_hit ++;
+  decoding.instr = e->instr_bytes;
+
+#ifdef DISASM_LOG
+  int i;
+  for (i = 0; i < e->instr.len && i < INSTR_MAX_LEN; i ++) {
+    decoding.p += sprintf(decoding.p, "%02x ", e->instr_bytes[i]);
+  }
+#endif
+
+  exec_decoded(&e->instr, eip);
+  return true;
+}
+
+void icache_invalidate_blk(uint32_t blk_begin, uint32_t blk_end) {
+  uint32_t blk;
+  for (blk = blk_begin; blk <= blk_end; blk ++) {
+    if (icache_blk_has_code[blk]) {
+      icache_blk_gen[blk] ++;
+      icache_blk_has_code[blk] = false;
+      icache_nr_inval ++;
+    }
+  }
+}
+
+void icache_flush(void) {
+  icache_epoch ++;
+  icache_nr_inval ++;
+}
+
+void icache_report(void) {
+  uint64_t total = nr_hit + nr_miss;
+  Log("icache: %" PRIu64 " hits, %" PRIu64 " misses, hit rate = %.2f%%",
+      nr_hit, nr_miss, (total == 0 ? 0.0 : 100.0 * nr_hit / total));
+}
@@ -1,16 +1,19 @@
 #include "cpu/exec.h"
 #include "memory/mmu.h"
 
+#define PF_IRQ 14
+
 void raise_intr(uint8_t NO, vaddr_t ret_addr) {
   /* TODO: Trigger an interrupt/exception with ``NO''.
    * That is, use ``NO'' to index the IDT.
    */
   if (NO > cpu.idtr.limit)
     assert(0);
-  rtl_push(&cpu.eflags);
-  cpu.IF = 0;
+  rtl_get_eflags(&t0);
+  rtl_push(&t0);
   rtl_push(&cpu.cs);
   rtl_push(&ret_addr);
+  cpu.IF = 0;
   
   vaddr_t idt_addr = cpu.idtr.base + NO * 8;
   uint32_t low = vaddr_read(idt_addr, 4);
@@ -20,6 +23,20 @@ void raise_intr(uint8_t NO, vaddr_t ret_addr) {
   decoding.is_jmp = 1;
 }
 
-void dev_raise_intr() {
-  cpu.INTR = true;
+/* The instruction at cpu.eip is aborted by a page fault. The prefixes
+ * it leaves are cleared, and the error code is pushed after eip. */
+void raise_page_fault(void) {
+#ifdef DIFF_TEST
+  bool is_rep = (decoding.rep != REP_NONE);
+#endif
+  decoding.is_operand_size_16 = false;
+  decoding.rep = REP_NONE;
+  raise_intr(PF_IRQ, cpu.eip);
+  rtl_push(&pf_err);
+  update_eip();
+
+#ifdef DIFF_TEST
+  void difftest_fault(bool);
+  difftest_fault(is_rep);
+#endif
 }
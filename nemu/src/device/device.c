@@ -1,53 +1,34 @@
 #include "common.h"
+#include "device/device.h"
+
+bool device_headless = false;
+const char *vga_checksum_file = NULL;
+uint32_t vga_dump_frame = 0;
+const char *vga_dump_file = NULL;
+const char *key_script_file = NULL;
 
 #ifdef HAS_IOE
 
-#include <sys/time.h>
-#include <signal.h>
+#include "device/event.h"
 #include <SDL2/SDL.h>
 
-#define TIMER_HZ 100
+#define SDL_HZ 100
 #define VGA_HZ 50
 
-static uint64_t jiffy = 0;
-static struct itimerval it;
-static int device_update_flag = false;
-static int update_screen_flag = false;
-
+void init_mmio();
+void init_pio();
+void init_intr();
 void init_serial();
 void init_timer();
 void init_vga();
 void init_i8042();
+void init_key_replay(const char *);
 
-extern void timer_intr();
 extern void send_key(uint8_t, bool);
 extern void update_screen();
+extern void vga_report();
 
-
-static void timer_sig_handler(int signum) {
-  jiffy ++;
-  timer_intr();
-
-  device_update_flag = true;
-  if (jiffy % (TIMER_HZ / VGA_HZ) == 0) {
-    update_screen_flag = true;
-  }
-
-  int ret = setitimer(ITIMER_VIRTUAL, &it, NULL);
-  Assert(ret == 0, "Can not set timer");
-}
-
-void device_update() {
-  if (!device_update_flag) {
-    return;
-  }
-  device_update_flag = false;
-
-  if (update_screen_flag) {
-    update_screen();
-    update_screen_flag = false;
-  }
-
+static void poll_event() {
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
     switch (event.type) {
@@ -69,30 +50,38 @@ void device_update() {
 }
 
 void sdl_clear_event_queue() {
+  if (device_headless) return;
   SDL_Event event;
   while (SDL_PollEvent(&event));
 }
 
 void init_device() {
+  init_mmio();
+  init_pio();
+  init_intr();
   init_serial();
   init_timer();
   init_vga();
   init_i8042();
 
-  struct sigaction s;
-  memset(&s, 0, sizeof(s));
-  s.sa_handler = timer_sig_handler;
-  int ret = sigaction(SIGVTALRM, &s, NULL);
-  Assert(ret == 0, "Can not set signal handler");
+  add_event("vga", GUEST_IPS / VGA_HZ, update_screen);
+  if (!device_headless) {
+    add_event("sdl", GUEST_IPS / SDL_HZ, poll_event);
+  }
+  if (key_script_file != NULL) {
+    init_key_replay(key_script_file);
+  }
+}
 
-  it.it_value.tv_sec = 0;
-  it.it_value.tv_usec = 1000000 / TIMER_HZ;
-  ret = setitimer(ITIMER_VIRTUAL, &it, NULL);
-  Assert(ret == 0, "Can not set timer");
+void device_report() {
+  vga_report();
 }
 #else
 
 void init_device() {
 }
 
+void device_report() {
+}
+
 #endif	/* HAS_IOE */
@@ -0,0 +1,72 @@
+#include "device/event.h"
+
+typedef struct {
+  const char *name;
+  uint64_t period;
+  uint64_t deadline;
+  event_handler_t handler;
+} Event;
+
+static Event events[NR_EVENT];
+static int nr_event = 0;
+
+uint64_t event_now = 0;
+uint64_t event_deadline = UINT64_MAX;
+
+static void update_deadline(void) {
+  int i;
+  event_deadline = UINT64_MAX;
+  for (i = 0; i < nr_event; i ++) {
+    if (events[i].deadline < event_deadline) {
+      event_deadline = events[i].deadline;
+    }
+  }
+}
+
+/* Add an event fired every `period' guest instructions.
+ * Return its number, which can be used to reprogram it later. */
+int add_event(const char *name, uint64_t period, event_handler_t handler) {
+  assert(nr_event < NR_EVENT);
+  assert(period > 0);
+  Event *ev = &events[nr_event];
+  ev->name = name;
+  ev->period = period;
+  ev->deadline = event_now + period;
+  ev->handler = handler;
+
+  update_deadline();
+  return nr_event ++;
+}
+
+void event_set_period(int NO, uint64_t period) {
+  assert(NO >= 0 && NO < nr_event);
+  assert(period > 0);
+  events[NO].period = period;
+  events[NO].deadline = event_now + period;
+  update_deadline();
+}
+
+/* Move the clock to `now', e.g. when a snapshot is loaded,
+ * and schedule every event a period later. */
+void event_reset(uint64_t now) {
+  int i;
+  event_now = now;
+  for (i = 0; i < nr_event; i ++) {
+    events[i].deadline = now + events[i].period;
+  }
+  update_deadline();
+}
+
+void event_dispatch(void) {
+  int i;
+  for (i = 0; i < nr_event; i ++) {
+    Event *ev = &events[i];
+    if (ev->deadline <= event_now) {
+      /* The block engine only stops at block boundaries, so an event
+       * may be fired a little late. Count the next period from now. */
+      ev->deadline = event_now + ev->period;
+      ev->handler();
+    }
+  }
+  update_deadline();
+}
@@ -0,0 +1,58 @@
+#include "nemu.h"
+#include "device/intr.h"
+#include "device/port-io.h"
+#include "monitor/snapshot.h"
+
+/* The ports have a bit for each IRQ line. Note that they are not
+ * compatible with the 8259 PIC.
+ *   INTR_PENDING_PORT: the pending lines, and writing 1 to a bit clears it
+ *   INTR_MASK_PORT:    the masked lines, only the timer is unmasked at reset
+ */
+#define INTR_PENDING_PORT 0x20
+#define INTR_MASK_PORT    0x21
+
+static uint8_t *intr_port_base;
+static struct {
+  uint8_t pending;
+  uint8_t mask;
+} intr = { .pending = 0, .mask = (uint8_t)~(1 << IRQ_TIMER) };
+
+/* cpu.INTR is set if any unmasked line is pending */
+static inline void intr_update(void) {
+  cpu.INTR = (intr.pending & ~intr.mask) != 0;
+}
+
+void dev_raise_intr(int irq) {
+  intr.pending |= 1 << irq;
+  intr_update();
+}
+
+/* Clear the unmasked pending line with the lowest number, and return
+ * its interrupt number, or -1 if there is none. */
+int intr_ack(void) {
+  uint8_t req = intr.pending & ~intr.mask;
+  if (req == 0) return -1;
+  int irq = __builtin_ctz(req);
+  intr.pending &= ~(1 << irq);
+  intr_update();
+  return IRQ_BASE + irq;
+}
+
+static void intr_io_handler(ioaddr_t addr, int len, bool is_write) {
+  assert(len == 1);
+  if (is_write) {
+    if (addr == INTR_PENDING_PORT) { intr.pending &= ~intr_port_base[0]; }
+    else { intr.mask = intr_port_base[1]; }
+    intr_update();
+  }
+  else {
+    intr_port_base[0] = intr.pending;
+    intr_port_base[1] = intr.mask;
+  }
+}
+
+void init_intr() {
+  intr_port_base = add_pio_map(INTR_PENDING_PORT, 2, intr_io_handler);
+
+  snapshot_add_region("intr", &intr, sizeof(intr));
+}
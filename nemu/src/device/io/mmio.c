@@ -1,22 +1,35 @@
 #include "common.h"
 #include "device/mmio.h"
+#include "memory/memory.h"
+#include "memory/mmu.h"
+#include "monitor/snapshot.h"
 
 #define MMIO_SPACE_MAX (512 * 1024)
 #define NR_MAP 8
 
-static uint8_t mmio_space_pool[MMIO_SPACE_MAX];
+void frame_map_add(paddr_t, paddr_t, int);
+
+static uint8_t mmio_space_pool[MMIO_SPACE_MAX] __attribute__((aligned(PAGE_SIZE)));
 static uint32_t mmio_space_free_index = 0;
 
+/* one byte for each page of the pool, set when a page of a
+ * memory-like map is written */
+static uint8_t mmio_dirty[MMIO_SPACE_MAX / PAGE_SIZE];
+
 typedef struct {
   paddr_t low;
   paddr_t high;
   uint8_t *mmio_space;
-  mmio_callback_t callback;
+  mmio_callback_t callback;  // NULL for memory-like maps
 } MMIO_t;
 
 static MMIO_t maps[NR_MAP];
 static int nr_map = 0;
 
+void init_mmio() {
+  snapshot_add_region("mmio", mmio_space_pool, MMIO_SPACE_MAX);
+}
+
 /* device interface */
 void* add_mmio_map(paddr_t addr, int len, mmio_callback_t callback) {
   assert(nr_map < NR_MAP);
@@ -27,11 +40,59 @@ void* add_mmio_map(paddr_t addr, int len, mmio_callback_t callback) {
   maps[nr_map].high = addr + len - 1;
   maps[nr_map].mmio_space = space_base;
   maps[nr_map].callback = callback;
+  frame_map_add(addr, addr + len - 1, nr_map);
   nr_map ++;
   mmio_space_free_index += len;
   return space_base;
 }
 
+/* A memory-like map has no side effect on access, so the bus accesses
+ * it directly like RAM. Writes to it are only recorded in the dirty
+ * pages, which the device collects with mmio_sync_dirty(). */
+void* add_mmio_mem_map(paddr_t addr, int len) {
+  assert((addr & PAGE_MASK) == 0 && (len & PAGE_MASK) == 0);
+  mmio_space_free_index = (mmio_space_free_index + PAGE_MASK) & ~PAGE_MASK;
+  return add_mmio_map(addr, len, NULL);
+}
+
+static inline void mark_dirty(uint8_t *p) {
+  mmio_dirty[(p - mmio_space_pool) / PAGE_SIZE] = 1;
+}
+
+/* Move the dirty bits of the memory-like map at `space' to `dirty',
+ * one byte for each page. Return whether any page is dirty. */
+bool mmio_sync_dirty(void *space, uint8_t *dirty) {
+  int i;
+  for (i = 0; i < nr_map; i ++) {
+    if (maps[i].mmio_space == space) break;
+  }
+  assert(i < nr_map && maps[i].callback == NULL);
+
+  uint8_t *d = &mmio_dirty[((uint8_t *)space - mmio_space_pool) / PAGE_SIZE];
+  int nr_page = (maps[i].high - maps[i].low + 1) / PAGE_SIZE;
+  bool any = false;
+  for (i = 0; i < nr_page; i ++) {
+    dirty[i] = d[i];
+    any |= d[i];
+  }
+  if (any) {
+    memset(d, 0, nr_page);
+    /* writes through the TLB only mark the page when the entry is filled */
+    tlb_flush();
+  }
+  return any;
+}
+
+/* Return the host address of `addr' in the map `map_NO' if it is
+ * memory-like, or NULL. */
+uint8_t* mmio_host(paddr_t addr, int map_NO, bool is_write) {
+  MMIO_t *map = &maps[map_NO];
+  if (map->callback != NULL) return NULL;
+  uint8_t *p = map->mmio_space + (addr - map->low);
+  if (is_write) { mark_dirty(p); }
+  return p;
+}
+
 /* bus interface */
 int is_mmio(paddr_t addr) {
   int i;
@@ -48,7 +109,7 @@ uint32_t mmio_read(paddr_t addr, int len, int map_NO) {
   MMIO_t *map = &maps[map_NO];
   uint32_t data = *(uint32_t *)(map->mmio_space + (addr - map->low)) 
     & (~0u >> ((4 - len) << 3));
-  map->callback(addr, len, false);
+  if (map->callback != NULL) { map->callback(addr, len, false); }
   return data;
 }
 
@@ -57,14 +118,8 @@ void mmio_write(paddr_t addr, int len, uint32_t data, int map_NO) {
   MMIO_t *map = &maps[map_NO];
 
   uint8_t *p = map->mmio_space + (addr - map->low);
-  uint8_t *p_data = (uint8_t *)&data;
-
-  switch (len) {
-    case 4: p[3] = p_data[3];
-    case 3: p[2] = p_data[2];
-    case 2: p[1] = p_data[1];
-    case 1: p[0] = p_data[0]; break;
-  }
+  memcpy(p, &data, len);
 
-  maps[map_NO].callback(addr, len, true);
+  if (map->callback != NULL) { map->callback(addr, len, true); }
+  else { mark_dirty(p); }
 }
@@ -1,5 +1,6 @@
 #include "common.h"
 #include "device/port-io.h"
+#include "monitor/snapshot.h"
 
 #define PORT_IO_SPACE_MAX 65536
 #define NR_MAP 8
@@ -26,6 +27,10 @@ static void pio_callback(ioaddr_t addr, int len, bool is_write) {
   }
 }
 
+void init_pio() {
+  snapshot_add_region("pio", pio_space, PORT_IO_SPACE_MAX);
+}
+
 /* device interface */
 void* add_pio_map(ioaddr_t addr, int len, pio_callback_t callback) {
   assert(nr_map < NR_MAP);
@@ -1,11 +1,15 @@
 #include "device/port-io.h"
 #include "monitor/monitor.h"
+#include "monitor/snapshot.h"
+#include "device/event.h"
+#include "device/intr.h"
 #include <SDL2/SDL.h>
+#include <stdlib.h>
+#include <inttypes.h>
 
 #define I8042_DATA_PORT 0x60
 #define I8042_STATUS_PORT 0x64
 #define I8042_STATUS_HASKEY_MASK 0x1
-#define KEYBOARD_IRQ 1
 
 static uint32_t *i8042_data_port_base;
 static uint8_t *i8042_status_port_base;
@@ -43,9 +47,81 @@ void send_key(uint8_t scancode, bool is_keydown) {
     uint32_t am_scancode = keymap[scancode] | (is_keydown ? KEYDOWN_MASK : 0);
     key_queue[key_r] = am_scancode;
     key_r = (key_r + 1) % KEY_QUEUE_LEN;
+    dev_raise_intr(IRQ_KEYBOARD);
   }
 }
 
+/* Key script, one key event per line:
+ *   <guest instructions> <key name> down|up
+ * e.g. "2000000 RETURN down". Key names are those in _KEYS.
+ * Keys are sent when the guest clock reaches their time, so a
+ * replay is reproducible. */
+typedef struct {
+  uint64_t time;
+  uint8_t scancode;
+  bool is_keydown;
+} ScriptKey;
+
+#define XX_NAME(k) { str(k), concat(SDL_SCANCODE_, k) },
+static const struct {
+  const char *name;
+  uint8_t scancode;
+} key_names[] = {
+  _KEYS(XX_NAME)
+};
+
+static ScriptKey *script = NULL;
+static int nr_script = 0, script_idx = 0;
+static int script_event;
+
+static void replay_key() {
+  for (; script_idx < nr_script && script[script_idx].time <= event_now; script_idx ++) {
+    send_key(script[script_idx].scancode, script[script_idx].is_keydown);
+  }
+  uint64_t next = (script_idx < nr_script ? script[script_idx].time - event_now : UINT64_MAX / 2);
+  event_set_period(script_event, next);
+}
+
+void init_key_replay(const char *file) {
+  FILE *fp = fopen(file, "r");
+  Assert(fp, "Can not open '%s'", file);
+
+  int max_script = 0, line = 0;
+  char buf[128];
+  while (fgets(buf, sizeof(buf), fp) != NULL) {
+    line ++;
+    uint64_t time;
+    char name[32], action[8];
+    if (buf[0] == '#' || buf[0] == '\n') continue;
+    Assert(sscanf(buf, "%" SCNu64 " %31s %7s", &time, name, action) == 3 &&
+        (strcmp(action, "down") == 0 || strcmp(action, "up") == 0),
+        "%s:%d: bad key event", file, line);
+    Assert(nr_script == 0 || time >= script[nr_script - 1].time,
+        "%s:%d: key events are not in time order", file, line);
+
+    int i;
+    for (i = 0; i < sizeof(key_names) / sizeof(key_names[0]); i ++) {
+      if (strcmp(name, key_names[i].name) == 0) break;
+    }
+    Assert(i < sizeof(key_names) / sizeof(key_names[0]), "%s:%d: unknown key '%s'", file, line, name);
+
+    if (nr_script == max_script) {
+      max_script = (max_script == 0 ? 64 : max_script * 2);
+      script = realloc(script, max_script * sizeof(script[0]));
+      assert(script != NULL);
+    }
+    script[nr_script].time = time;
+    script[nr_script].scancode = key_names[i].scancode;
+    script[nr_script].is_keydown = (action[0] == 'd');
+    nr_script ++;
+  }
+  fclose(fp);
+
+  Log("%d key events are loaded from %s", nr_script, file);
+  uint64_t first = (nr_script > 0 && script[0].time > event_now ? script[0].time - event_now : 1);
+  script_event = add_event("keys", first, replay_key);
+}
+
 void i8042_io_handler(ioaddr_t addr, int len, bool is_write) {
   if (!is_write) {
     if (addr == I8042_DATA_PORT) {
@@ -67,4 +143,8 @@ void init_i8042() {
   i8042_data_port_base = add_pio_map(I8042_DATA_PORT, 4, i8042_io_handler);
   i8042_status_port_base = add_pio_map(I8042_STATUS_PORT, 1, i8042_io_handler);
   i8042_status_port_base[0] = 0x0;
+
+  snapshot_add_region("keyq", key_queue, sizeof(key_queue));
+  snapshot_add_region("keyf", &key_f, sizeof(key_f));
+  snapshot_add_region("keyr", &key_r, sizeof(key_r));
 }
@@ -1,13 +1,39 @@
 #include "device/port-io.h"
+#include "device/event.h"
+#include "device/intr.h"
 #include "monitor/monitor.h"
+#include "monitor/snapshot.h"
 #include <sys/time.h>
 
 #define RTC_PORT 0x48   // Note that this is not the standard
+#define TIMER_PORT 0x40 // Note that this is not the standard, either
+#define TIMER_HZ 100
+
+/* The guest writes the period of the timer interrupt to TIMER_PORT,
+ * in microseconds of guest time, or 0 to stop the timer. The RTC also
+ * counts guest time, from the host time when NEMU starts, so that the
+ * uptime the guest measures is the same in every run. */
+static uint32_t *timer_port_base;
+static struct {
+  uint32_t period_us;
+  uint32_t rtc_base;    // the RTC at clock 0, in ms
+} timer = { .period_us = 1000000 / TIMER_HZ };
+static uint32_t timer_event_period_us;
+static int timer_event;
+
+static void timer_set_period(uint32_t us) {
+  timer.period_us = us;
+  timer_event_period_us = us;
+  event_set_period(timer_event, (us == 0 ? UINT64_MAX / 2 : (uint64_t)us * (GUEST_IPS / 1000000)));
+}
 
 void timer_intr() {
-  if (nemu_state == NEMU_RUNNING) {
-    extern void dev_raise_intr(void);
-    dev_raise_intr();
+  if (timer_event_period_us != timer.period_us) {
+    /* the period is restored from a snapshot */
+    timer_set_period(timer.period_us);
+  }
+  if (nemu_state == NEMU_RUNNING && timer.period_us != 0) {
+    dev_raise_intr(IRQ_TIMER);
   }
 }
 
@@ -15,14 +41,29 @@ static uint32_t *rtc_port_base;
 
 void rtc_io_handler(ioaddr_t addr, int len, bool is_write) {
   if (!is_write) {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    uint32_t seconds = now.tv_sec;
-    uint32_t useconds = now.tv_usec;
-    rtc_port_base[0] = seconds * 1000 + (useconds + 500) / 1000;
+    rtc_port_base[0] = timer.rtc_base + event_now / (GUEST_IPS / 1000);
+  }
+}
+
+void timer_io_handler(ioaddr_t addr, int len, bool is_write) {
+  assert(len == 4);
+  if (is_write) {
+    timer_set_period(timer_port_base[0]);
+  }
+  else {
+    timer_port_base[0] = timer.period_us;
   }
 }
 
 void init_timer() {
   rtc_port_base = add_pio_map(RTC_PORT, 4, rtc_io_handler);
+  timer_port_base = add_pio_map(TIMER_PORT, 4, timer_io_handler);
+
+  timer_event = add_event("timer", 1, timer_intr);
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  timer.rtc_base = (uint32_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+
+  timer_set_period(timer.period_us);
+  snapshot_add_region("timer", &timer, sizeof(timer));
 }
@@ -3,7 +3,11 @@
 #ifdef HAS_IOE
 
 #include "device/mmio.h"
+#include "device/device.h"
+#include "memory/mmu.h"
+#include "monitor/snapshot.h"
 #include <SDL2/SDL.h>
+#include <inttypes.h>
 
 #define VMEM 0x40000
 
@@ -16,23 +20,139 @@ static SDL_Texture *texture;
 
 static uint32_t (*vmem) [SCREEN_W];
 
-void vga_vmem_io_handler(paddr_t addr, int len, bool is_write) {
+#define VMEM_SIZE 0x80000
+#define NR_VMEM_PAGE (VMEM_SIZE / PAGE_SIZE)
+
+/* Scanlines written since the last refresh. Only they are uploaded to
+ * the texture, and the screen is not presented if none is written.
+ * vmem is memory-like, so writes are collected from its dirty pages. */
+static bool dirty[SCREEN_H];
+static int dirty_low = 0, dirty_high = SCREEN_H - 1;
+static uint64_t nr_present = 0, nr_skip = 0;
+
+/* frame number, counted at every refresh */
+static uint32_t nr_frame = 0;
+static uint32_t checksum;
+static FILE *checksum_fp = NULL;
+
+static inline void mark_dirty(int row) {
+  if (row >= SCREEN_H) return;
+  dirty[row] = true;
+  if (row < dirty_low) dirty_low = row;
+  if (row > dirty_high) dirty_high = row;
+}
+
+/* vmem may be restored from a snapshot without any write */
+static void mark_all_dirty() {
+  memset(dirty, true, sizeof(dirty));
+  dirty_low = 0;
+  dirty_high = SCREEN_H - 1;
+}
+
+static void collect_dirty() {
+  uint8_t page_dirty[NR_VMEM_PAGE];
+  if (!mmio_sync_dirty(vmem, page_dirty)) return;
+
+  int i, row;
+  for (i = 0; i < NR_VMEM_PAGE; i ++) {
+    if (!page_dirty[i]) continue;
+    for (row = i * PAGE_SIZE / sizeof(vmem[0]); row <= ((i + 1) * PAGE_SIZE - 1) / sizeof(vmem[0]); row ++) {
+      mark_dirty(row);
+    }
+  }
+}
+
+/* FNV-1a hash of the screen */
+static uint32_t screen_checksum() {
+  const uint8_t *p = (const uint8_t *)vmem;
+  uint32_t h = 2166136261u;
+  int i;
+  for (i = 0; i < SCREEN_H * sizeof(vmem[0]); i ++) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void dump_screen(const char *file) {
+  FILE *fp = fopen(file, "wb");
+  if (fp == NULL) {
+    Log("Can not open '%s' to dump the screen", file);
+    return;
+  }
+  fprintf(fp, "P6\n%d %d\n255\n", SCREEN_W, SCREEN_H);
+  int i, j;
+  for (i = 0; i < SCREEN_H; i ++) {
+    for (j = 0; j < SCREEN_W; j ++) {
+      uint32_t c = vmem[i][j];
+      uint8_t rgb[3] = { c >> 16, c >> 8, c };
+      fwrite(rgb, sizeof(rgb), 1, fp);
+    }
+  }
+  fclose(fp);
+  Log("Frame %d is dumped to %s", nr_frame, file);
 }
 
 void update_screen() {
-  SDL_UpdateTexture(texture, NULL, vmem, SCREEN_W * sizeof(vmem[0][0]));
-  SDL_RenderClear(renderer);
-  SDL_RenderCopy(renderer, texture, NULL, NULL);
-  SDL_RenderPresent(renderer);
+  collect_dirty();
+  nr_frame ++;
+  bool is_dirty = (dirty_low <= dirty_high);
+  if (checksum_fp != NULL) {
+    if (is_dirty) { checksum = screen_checksum(); }
+    fprintf(checksum_fp, "%d %08x\n", nr_frame, checksum);
+  }
+  if (vga_dump_file != NULL && nr_frame == vga_dump_frame) {
+    dump_screen(vga_dump_file);
+  }
+
+  if (!is_dirty) {
+    nr_skip ++;
+    return;
+  }
+
+  /* upload each run of dirty scanlines */
+  int i, j;
+  for (i = dirty_low; i <= dirty_high; i = j) {
+    for (j = i; j <= dirty_high && dirty[j]; j ++) { dirty[j] = false; }
+    if (j > i) {
+      if (!device_headless) {
+        SDL_Rect rect = { .x = 0, .y = i, .w = SCREEN_W, .h = j - i };
+        SDL_UpdateTexture(texture, &rect, vmem[i], sizeof(vmem[0]));
+      }
+    }
+    else { j ++; }
+  }
+  dirty_low = SCREEN_H;
+  dirty_high = -1;
+
+  if (!device_headless) {
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, texture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+  }
+  nr_present ++;
+}
+
+void vga_report() {
+  Log("vga: %" PRIu64 " frames presented, %" PRIu64 " skipped", nr_present, nr_skip);
+  if (checksum_fp != NULL) { fflush(checksum_fp); }
 }
 
 void init_vga() {
-  SDL_Init(SDL_INIT_VIDEO);
-  SDL_CreateWindowAndRenderer(SCREEN_W * 2, SCREEN_H * 2, 0, &window, &renderer);
-  SDL_SetWindowTitle(window, "NEMU");
-  texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-      SDL_TEXTUREACCESS_STATIC, SCREEN_W, SCREEN_H);
+  if (!device_headless) {
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_CreateWindowAndRenderer(SCREEN_W * 2, SCREEN_H * 2, 0, &window, &renderer);
+    SDL_SetWindowTitle(window, "NEMU");
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STATIC, SCREEN_W, SCREEN_H);
+  }
+
+  if (vga_checksum_file != NULL) {
+    checksum_fp = fopen(vga_checksum_file, "w");
+    Assert(checksum_fp, "Can not open '%s'", vga_checksum_file);
+  }
 
-  vmem = add_mmio_map(VMEM, 0x80000, vga_vmem_io_handler);
+  vmem = add_mmio_mem_map(VMEM, VMEM_SIZE);
+  mark_all_dirty();
+  snapshot_add_hook(mark_all_dirty);
 }
 #endif	/* HAS_IOE */
@@ -1,5 +1,6 @@
 int init_monitor(int, char *[]);
 void ui_mainloop(int);
+void fini_monitor();
 
 int main(int argc, char *argv[]) {
   /* Initialize the monitor. */
@@ -8,5 +9,7 @@ int main(int argc, char *argv[]) {
   /* Receive commands from user. */
   ui_mainloop(is_batch_mode);
 
+  fini_monitor();
+
   return 0;
 }
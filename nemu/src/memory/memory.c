@@ -1,11 +1,22 @@
 #include "nemu.h"
+#include "memory/mmu.h"
+#include "cpu/icache.h"
+#include "monitor/watchpoint.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
-#define PMEM_SIZE (128 * 1024 * 1024)
-
-#define pmem_rw(addr, type) *(type *)({\
-    Assert(addr < PMEM_SIZE, "physical address(0x%08x) is out of bound", addr); \
-    guest_to_host(addr); \
-    })
+/* Load only `len' bytes, so that a read at the end of RAM or of a
+ * memory-like MMIO map never touches the byte past it */
+static inline uint32_t host_read(const uint8_t *p, int len) {
+  switch (len) {
+    case 4: return *(uint32_t *)p;
+    case 2: return *(uint16_t *)p;
+    case 1: return *p;
+    default: { uint32_t data = 0; memcpy(&data, p, len); return data; }
+  }
+}
 
 // Page directory and page table constants
 #define PGSHFT    12      // log2(PGSIZE)
@@ -25,62 +36,373 @@
 #define PTE_ADDR(pte)   ((uint32_t)(pte) & ~0xfff)
 #define PG_BEGIN(va)   ((va) & ~0xfff)
 
-uint8_t pmem[PMEM_SIZE];
+// Software TLB, direct-mapped and indexed by virtual page number
+#define TLB_NR_ENTRY 256
+
+enum { TLB_READ, TLB_WRITE, TLB_FETCH, NR_TLB_TYPE };
+
+typedef struct {
+  uint32_t vpn;
+  paddr_t pbase;
+  uint8_t *host;  // NULL if the frame is not entirely RAM
+} TLBEntry;
+
+static TLBEntry tlb[NR_TLB_TYPE][TLB_NR_ENTRY];
+static uint64_t tlb_nr_hit[NR_TLB_TYPE], tlb_nr_miss[NR_TLB_TYPE];
+
+/* Guest RAM is an anonymous mapping, so its pages are only allocated
+ * by the host when they are touched. */
+uint8_t *pmem = NULL;
+uint32_t pmem_size = 0;
+uint8_t pmem_touched[PMEM_MAX_SIZE / PAGE_SIZE];
+
+void init_pmem(uint32_t size) {
+  Assert(size > 0 && size <= PMEM_MAX_SIZE && (size & PAGE_MASK) == 0,
+      "Invalid physical memory size 0x%x", size);
+  pmem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  Assert(pmem != MAP_FAILED, "Can not allocate the physical memory");
+  pmem_size = size;
+  Log("Physical memory size = %d MiB", size >> 20);
+}
+
+/* Make pmem all zero, and give its pages back to the host. pmem is
+ * mapped again, since MADV_DONTNEED would bring back the content of
+ * the pages mapped from files. */
+void pmem_reset(void) {
+  if (mmap(pmem, pmem_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED) {
+    memset(pmem, 0, pmem_size);
+  }
+  memset(pmem_touched, 0, sizeof(pmem_touched));
+}
+
+/* Load `len' bytes of `fd' from `offset' to pmem at `addr'. The whole
+ * pages are mapped copy-on-write instead of being read, so that they
+ * are only read from the file when the guest accesses them. */
+bool pmem_map_file(paddr_t addr, int fd, off_t offset, uint32_t len) {
+  if (len == 0) return true;
+  if (addr >= pmem_size || len > pmem_size - addr) return false;
+
+  uint32_t head = 0, tail = 0;
+  if (((addr ^ offset) & PAGE_MASK) == 0) {
+    head = (PAGE_SIZE - (addr & PAGE_MASK)) & PAGE_MASK;
+    if (head < len) {
+      uint32_t nr_map = (len - head) & ~PAGE_MASK;
+      if (nr_map != 0 && mmap(guest_to_host(addr + head), nr_map, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_FIXED, fd, offset + head) != MAP_FAILED) {
+        tail = head + nr_map;
+      }
+    }
+  }
+
+  /* read the partial pages, or everything if the file can not be mapped */
+  if (tail == 0) {
+    head = len;
+    tail = len;
+  }
+  bool ok = pread(fd, guest_to_host(addr), head, offset) == head &&
+    pread(fd, guest_to_host(addr + tail), len - tail, offset + tail) == len - tail;
+  pmem_touch(addr, len);
+  return ok;
+}
+
+/* The pages written since the last checkpoint, and their content at
+ * the checkpoint. A page is saved before its first write, which comes
+ * through paddr_write(), or frame_host() when it is filled to the TLB. */
+static bool pmem_ckpt_on = false;
+static uint8_t pmem_mark_val = PMEM_TOUCHED;
+static uint32_t *ckpt_pfn = NULL;
+static uint8_t *ckpt_data = NULL;
+static uint32_t ckpt_nr_page = 0, ckpt_max_page = 0;
+
+static void pmem_mark_slow(uint32_t pfn) {
+  if (pmem_ckpt_on && !(pmem_touched[pfn] & PMEM_DIRTY)) {
+    if (ckpt_nr_page == ckpt_max_page) {
+      ckpt_max_page = (ckpt_max_page == 0 ? 64 : ckpt_max_page * 2);
+      ckpt_pfn = realloc(ckpt_pfn, ckpt_max_page * sizeof(*ckpt_pfn));
+      ckpt_data = realloc(ckpt_data, (size_t)ckpt_max_page * PAGE_SIZE);
+      Assert(ckpt_pfn != NULL && ckpt_data != NULL, "Can not save the pages of the checkpoint");
+    }
+    ckpt_pfn[ckpt_nr_page] = pfn;
+    memcpy(ckpt_data + (size_t)ckpt_nr_page * PAGE_SIZE, guest_to_host(pfn * PAGE_SIZE), PAGE_SIZE);
+    ckpt_nr_page ++;
+  }
+  pmem_touched[pfn] = pmem_mark_val;
+}
+
+static inline void pmem_mark(uint32_t pfn) {
+  if (pmem_touched[pfn] != pmem_mark_val) { pmem_mark_slow(pfn); }
+}
+
+/* called when [addr, addr + len) is written without paddr_write() */
+void pmem_touch(paddr_t addr, uint32_t len) {
+  if (len == 0) return;
+  uint32_t pfn;
+  for (pfn = addr >> PGSHFT; pfn <= (addr + len - 1) >> PGSHFT; pfn ++) {
+    pmem_mark(pfn);
+  }
+}
+
+/* Start a new checkpoint of pmem at the current content. The TLB is
+ * flushed, so that the first write to every page is seen again. */
+void pmem_checkpoint(void) {
+  uint32_t i;
+  for (i = 0; i < ckpt_nr_page; i ++) {
+    pmem_touched[ckpt_pfn[i]] &= ~PMEM_DIRTY;
+  }
+  ckpt_nr_page = 0;
+  pmem_ckpt_on = true;
+  pmem_mark_val = PMEM_TOUCHED | PMEM_DIRTY;
+  tlb_flush();
+}
+
+/* Bring pmem back to the last checkpoint. The written pages are still
+ * listed by pmem_dirty_pages() until the next checkpoint. */
+void pmem_rollback(void) {
+  uint32_t i;
+  for (i = 0; i < ckpt_nr_page; i ++) {
+    memcpy(guest_to_host(ckpt_pfn[i] * PAGE_SIZE), ckpt_data + (size_t)i * PAGE_SIZE, PAGE_SIZE);
+  }
+  icache_flush();
+  tlb_flush();
+}
+
+/* Return the number of pages written since the last checkpoint, their
+ * frame numbers in `*pfn', and their content at the checkpoint in `*old'. */
+uint32_t pmem_dirty_pages(const uint32_t **pfn, const uint8_t **old) {
+  *pfn = ckpt_pfn;
+  *old = ckpt_data;
+  return ckpt_nr_page;
+}
+
+/* Physical memory map, one entry for each frame of pmem.
+ * An entry is either FRAME_RAM, FRAME_MIXED if only part of the frame
+ * is covered by MMIO maps, or the number of the map covering the frame.
+ */
+#define NR_FRAME (PMEM_MAX_SIZE / PAGE_SIZE)
+#define FRAME_RAM   -1
+#define FRAME_MIXED -2
+
+static int8_t frame_map[NR_FRAME];
 
 int is_mmio(paddr_t addr);
 uint32_t mmio_read(paddr_t addr, int len, int map_NO);
 void mmio_write(paddr_t addr, int len, uint32_t data, int map_NO);
+uint8_t* mmio_host(paddr_t addr, int map_NO, bool is_write);
+
+void init_frame_map(void) {
+  memset(frame_map, FRAME_RAM, pmem_size / PAGE_SIZE);
+}
+
+/* called when [low, high] is mapped to the MMIO map `map_NO' */
+void frame_map_add(paddr_t low, paddr_t high, int map_NO) {
+  uint32_t f;
+  for (f = low >> PGSHFT; f <= (high >> PGSHFT) && f < pmem_size / PAGE_SIZE; f ++) {
+    bool whole = (f << PGSHFT) >= low && ((f << PGSHFT) | PAGE_MASK) <= high;
+    frame_map[f] = (whole && frame_map[f] == FRAME_RAM ? map_NO : FRAME_MIXED);
+  }
+}
+
+/* Return the MMIO map `addr' belongs to, or -1 for RAM. */
+static inline int frame_lookup(paddr_t addr) {
+  if (addr < pmem_size) {
+    int map_NO = frame_map[addr >> PGSHFT];
+    if (map_NO != FRAME_MIXED) return map_NO;
+  }
+  return is_mmio(addr);
+}
+
 /* Memory accessing interfaces */
 
 uint32_t paddr_read(paddr_t addr, int len) {
   int map_NO;
-  if ((map_NO = is_mmio(addr)) < 0)
-    return pmem_rw(addr, uint32_t) & (~0u >> ((4 - len) << 3));
+  if ((map_NO = frame_lookup(addr)) < 0) {
+    Assert(addr + len <= pmem_size, "physical address(0x%08x) is out of bound", addr);
+    return host_read(guest_to_host(addr), len);
+  }
   return mmio_read(addr, len, map_NO);
 }
 
 void paddr_write(paddr_t addr, int len, uint32_t data) {
   int map_NO;
-  if ((map_NO = is_mmio(addr)) < 0)
+  if ((map_NO = frame_lookup(addr)) < 0) {
+    Assert(addr + len <= pmem_size, "physical address(0x%08x) is out of bound", addr);
+    icache_check_write(addr, len);
+    pmem_mark(addr >> PGSHFT);
     memcpy(guest_to_host(addr), &data, len);
+  }
   else
     mmio_write(addr, len, data, map_NO);
 }
 
+/* Return the host address of the frame at `pbase' if the whole frame
+ * can be accessed directly, i.e. it is RAM or in a memory-like MMIO map,
+ * or NULL. Writes through the returned address do not mark the page
+ * one by one, so it is marked here. */
+static inline uint8_t* frame_host(paddr_t pbase, bool is_write) {
+  if (pbase >= pmem_size) return NULL;
+  int map_NO = frame_map[pbase >> PGSHFT];
+  if (map_NO == FRAME_RAM) {
+    if (is_write) { pmem_mark(pbase >> PGSHFT); }
+    return guest_to_host(pbase);
+  }
+  return (map_NO >= 0 ? mmio_host(pbase, map_NO, is_write) : NULL);
+}
+
+jmp_buf *pf_jmp = NULL;
+uint32_t pf_err = 0;
+
+static void page_fault(vaddr_t addr, bool is_write) {
+  Assert(pf_jmp != NULL, "page fault at address 0x%08x, eip = 0x%08x", addr, cpu.eip);
+  cpu.cr2 = addr;
+  pf_err = (is_write ? PF_ERR_W : 0);
+  longjmp(*pf_jmp, 1);
+}
+
 // Access bit and dirty bit haven't been implemented!
-static paddr_t page_translate(vaddr_t addr) {
+static inline paddr_t page_walk(vaddr_t addr, bool is_write) {
   if (!cpu.PG)
     return (paddr_t)addr;
     
   uint32_t PDE, PTE;
   PDE = paddr_read(cpu.cr3 + 4 * PDX(addr), 4);
-  assert((PDE & PTE_P) == 1);
+  if ((PDE & PTE_P) == 0) page_fault(addr, is_write);
   
   PTE = paddr_read(PTE_ADDR(PDE) + 4 * PTX(addr), 4);
-  assert((PTE & PTE_P) == 1);
+  if ((PTE & PTE_P) == 0) page_fault(addr, is_write);
   
   return (paddr_t)(PTE_ADDR(PTE) | OFF(addr));
 }
 
-uint32_t vaddr_read(vaddr_t addr, int len) {
+paddr_t page_translate(vaddr_t addr) {
+  return page_walk(addr, false);
+}
+
+void tlb_flush(void) {
+  memset(tlb, 0xff, sizeof(tlb));
+}
+
+/* Drop the translations of the page at `addr' */
+void tlb_invalidate(vaddr_t addr) {
+  uint32_t vpn = addr >> PGSHFT;
+  int type;
+  for (type = 0; type < NR_TLB_TYPE; type ++) {
+    TLBEntry *e = &tlb[type][vpn & (TLB_NR_ENTRY - 1)];
+    if (e->vpn == vpn) { e->vpn = ~0u; }
+  }
+}
+
+void tlb_report(void) {
+  static const char *name[] = { "read", "write", "fetch" };
+  int i;
+  for (i = 0; i < NR_TLB_TYPE; i ++) {
+    uint64_t total = tlb_nr_hit[i] + tlb_nr_miss[i];
+    Log("tlb %s: %" PRIu64 " hits, %" PRIu64 " misses, hit rate = %.2f%%", name[i],
+        tlb_nr_hit[i], tlb_nr_miss[i], (total == 0 ? 0.0 : 100.0 * tlb_nr_hit[i] / total));
+  }
+}
+
+static inline TLBEntry* tlb_lookup(vaddr_t addr, int type) {
+  uint32_t vpn = addr >> PGSHFT;
+  TLBEntry *e = &tlb[type][vpn & (TLB_NR_ENTRY - 1)];
+  if (e->vpn != vpn) {
+    tlb_nr_miss[type] ++;
+    paddr_t pbase = page_walk(addr & ~PAGE_MASK, type == TLB_WRITE);
+    e->vpn = vpn;
+    e->pbase = pbase;
+    e->host = frame_host(pbase, type == TLB_WRITE);
+  }
+  else {
+    tlb_nr_hit[type] ++;
+  }
+  return e;
+}
+
+static inline uint32_t vaddr_read_page(vaddr_t addr, int len, int type) {
+  if (!cpu.PG) {
+    return paddr_read(addr, len);
+  }
+  TLBEntry *e = tlb_lookup(addr, type);
+  if (e->host != NULL) {
+    return host_read(e->host + OFF(addr), len);
+  }
+  return paddr_read(e->pbase | OFF(addr), len);
+}
+
+static inline void vaddr_write_page(vaddr_t addr, int len, uint32_t data) {
+  if (!cpu.PG) {
+    paddr_write(addr, len, data);
+    return;
+  }
+  TLBEntry *e = tlb_lookup(addr, TLB_WRITE);
+  if (e->host != NULL) {
+    icache_check_write(e->pbase | OFF(addr), len);
+    memcpy(e->host + OFF(addr), &data, len);
+  }
+  else {
+    paddr_write(e->pbase | OFF(addr), len, data);
+  }
+}
+
+static inline uint32_t vaddr_access(vaddr_t addr, int len, int type) {
   vaddr_t next_page_begin = PG_BEGIN(addr + len - 1);
   if (PG_BEGIN(addr) != next_page_begin) {
     int fst_half_len = next_page_begin - addr;
-    uint32_t fst_val = paddr_read(page_translate(addr), fst_half_len);
-    uint32_t snd_val = paddr_read(page_translate(next_page_begin), len - fst_half_len);
+    uint32_t fst_val = vaddr_read_page(addr, fst_half_len, type);
+    uint32_t snd_val = vaddr_read_page(next_page_begin, len - fst_half_len, type);
     return ((snd_val << (fst_half_len << 3)) | fst_val);
-  }   
-  else 
-    return paddr_read(page_translate(addr), len);
+  }
+  else
+    return vaddr_read_page(addr, len, type);
+}
+
+uint32_t vaddr_read(vaddr_t addr, int len) {
+  return vaddr_access(addr, len, TLB_READ);
+}
+
+uint32_t vaddr_fetch(vaddr_t addr, int len) {
+  return vaddr_access(addr, len, TLB_FETCH);
 }
 
 void vaddr_write(vaddr_t addr, int len, uint32_t data) {
   vaddr_t next_page_begin = PG_BEGIN(addr + len - 1);
   if (PG_BEGIN(addr) != next_page_begin) {
     int fst_half_len = next_page_begin - addr;
-    paddr_write(page_translate(addr), fst_half_len, data);
-    paddr_write(page_translate(next_page_begin), len - fst_half_len, (data >> (fst_half_len << 3)));
+    vaddr_write_page(addr, fst_half_len, data);
+    vaddr_write_page(next_page_begin, len - fst_half_len, (data >> (fst_half_len << 3)));
   } 
   else
-    paddr_write(page_translate(addr), len, data);
+    vaddr_write_page(addr, len, data);
+
+  if (nr_trap_wp != 0) {
+    wp_check_write(addr, len);
+  }
+}
+
+/* Return the host address of [addr, addr + len), which should be in
+ * one page, if it can be accessed directly, or NULL. It is used for
+ * bulk accesses, so the range to write is invalidated in the icache
+ * at once. Write traps need every write to go through vaddr_write().
+ */
+uint8_t* vaddr_host(vaddr_t addr, int len, bool is_write) {
+  if (is_write && nr_trap_wp != 0) return NULL;
+
+  paddr_t pbase;
+  uint8_t *host;
+  if (cpu.PG) {
+    TLBEntry *e = tlb_lookup(addr, is_write ? TLB_WRITE : TLB_READ);
+    pbase = e->pbase;
+    host = e->host;
+  }
+  else {
+    pbase = addr & ~PAGE_MASK;
+    host = frame_host(pbase, is_write);
+  }
+  if (host == NULL) return NULL;
+
+  if (is_write) {
+    icache_check_write(pbase | OFF(addr), len);
+  }
+  return host + OFF(addr);
 }
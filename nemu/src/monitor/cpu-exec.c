@@ -1,5 +1,13 @@
 #include "nemu.h"
 #include "monitor/monitor.h"
+#include "cpu/icache.h"
+#include "cpu/bb.h"
+#include "device/event.h"
+#include "monitor/prof.h"
+#include "monitor/itrace.h"
+#include "monitor/watchpoint.h"
+#include <sys/time.h>
+#include <inttypes.h>
 
 /* The assembly code of instructions executed is only output to the screen
  * when the number of instructions executed is less than this value.
@@ -10,8 +18,31 @@
 
 int nemu_state = NEMU_STOP;
 
+static uint64_t g_nr_guest_instr = 0;
+static uint64_t g_timer = 0; // unit: us
+
 void exec_wrapper(bool);
-bool check_watchpoints();
+void raise_page_fault(void);
+void device_report(void);
+
+static uint64_t get_time(void) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec * 1000000ull + now.tv_usec;
+}
+
+static void print_statistic(void) {
+  Log("total guest instructions = %" PRIu64 ", time = %" PRIu64 " us, %.2f MIPS",
+      g_nr_guest_instr, g_timer, (g_timer == 0 ? 0.0 : (double)g_nr_guest_instr / g_timer));
+  tlb_report();
+  icache_report();
+  bb_report();
+  device_report();
+  if (prof_enable) {
+    prof_report(20);
+    if (prof_file != NULL) { prof_dump(prof_file); }
+  }
+}
 
 /* Simulate how the CPU works. */
 void cpu_exec(uint64_t n) {
@@ -23,23 +54,58 @@ void cpu_exec(uint64_t n) {
 
   bool print_flag = n < MAX_INSTR_TO_PRINT;
 
-  for (; n > 0; n --) {
-    /* Execute one instruction, including instruction fetch,
-     * instruction decode, and the actual execution. */
-    exec_wrapper(print_flag);
-
+  /* The block engine neither prints instructions nor checks
+   * watchpoints after each of them, and it is neither profiled nor traced.
+   * Write traps work with it, since they stop the running block. */
+  bool use_bb = bb_engine && !print_flag && !prof_enable && !itrace_enable && nr_expr_wp == 0;
 #ifdef DEBUG
-		if (check_watchpoints()) 
-			nemu_state = NEMU_STOP;
+  use_bb = false;
 #endif
 
-#ifdef HAS_IOE
-    extern void device_update();
-    device_update();
-#endif
+  volatile uint64_t n_remain = n;
+  uint64_t timer_start = get_time();
 
-    if (nemu_state != NEMU_RUNNING) { return; }
+  jmp_buf pf_buf;
+  if (setjmp(pf_buf) != 0) {
+    /* An instruction is aborted by a page fault. Raising it is counted
+     * as an instruction, after those done by the block it aborts. A
+     * double fault stops NEMU. */
+    pf_jmp = NULL;
+    raise_page_fault();
+    uint64_t nr_exec = (use_bb ? bb_abort() : 0) + 1;
+    n_remain -= nr_exec;
+    event_advance(nr_exec);
   }
+  pf_jmp = &pf_buf;
+
+  while (n_remain > 0 && nemu_state == NEMU_RUNNING) {
+    uint64_t nr_exec;
+    if (use_bb) {
+      /* Execute a basic block, with interrupts checked at its end. */
+      nr_exec = bb_exec(n_remain);
+    }
+    else {
+      /* Execute one instruction, including instruction fetch,
+       * instruction decode, and the actual execution. */
+      exec_wrapper(print_flag);
+      nr_exec = 1;
+    }
+    n_remain -= nr_exec;
+
+    if (nr_expr_wp != 0 && check_watchpoints()) {
+      nemu_state = NEMU_STOP;
+    }
+
+    /* fire device events whose deadlines are reached */
+    event_advance(nr_exec);
+
+    if (nemu_state != NEMU_RUNNING) { break; }
+  }
+  pf_jmp = NULL;
+
+  g_timer += get_time() - timer_start;
+  g_nr_guest_instr += n - n_remain;
 
   if (nemu_state == NEMU_RUNNING) { nemu_state = NEMU_STOP; }
+  else if (nemu_state == NEMU_END) { print_statistic(); }
 }
@@ -1,4 +1,5 @@
 #include "nemu.h"
+#include "monitor/expr.h"
 
 /* We use the POSIX regex functions to process regular expressions.
  * Type 'man regex' for more information about POSIX regex functions.
@@ -281,34 +282,50 @@ static int find_reg_index(char *reg, const char *regs[8]) {
 	return -1;
 }
 
-static uint32_t regname_to_val(char *name) {
+static const void *regname_to_ptr(char *name, int *width) {
 	int index;
+	*width = 4;
 	if (strcmp(name, "eip") == 0)
-		return cpu.eip;
+		return &cpu.eip;
 	else if (name[0] == 'e') {
 		index = find_reg_index(name, regsl);
 		Assert(index >= 0, "Error: %s doesn't exist!", name);
-		return reg_l(index);
+		return &reg_l(index);
 	}
 	else {
 		index = find_reg_index(name, regsw);
-		if (index >= 0) 
-			return reg_w(index);
+		if (index >= 0) {
+			*width = 2;
+			return &reg_w(index);
+		}
 
 		index = find_reg_index(name, regsb);
 		Assert(index >= 0, "Error: %s doesn't exist!", name);
-		return reg_b(index);
+		*width = 1;
+		return &reg_b(index);
 	}	
 }
 
-static int eval(int p, int q, bool *success) {
+static void emit(ExprCode *code, int op) {
+	Assert(code->nr_code < EXPR_MAX_CODE, "Expression code overflow!");
+	code->code[code->nr_code].op = op;
+	code->nr_code++;
+}
+
+static void emit_imm(ExprCode *code, int32_t imm) {
+	emit(code, TK_DINT);
+	code->code[code->nr_code - 1].imm = imm;
+}
+
+/* Translate tokens[p..q] into postfix code. */
+static void compile(int p, int q, ExprCode *code, bool *success) {
 	if (!(*success))
-		return -1;
+		return;
 
 	if (p > q) {
 		*success = false;
 		print_error("Syntex Error: Bad expression!");
-		return -1;	
+		return;
 	}	
 
 	/* Process DINT, HINT and REG */
@@ -321,21 +338,26 @@ static int eval(int p, int q, bool *success) {
 			if (!str || (sscanf(str, "%x", &val) != 1)) {
 				*success = false;
 				print_error("Error: Fail to read hexadecimal number!");
-				return -1;
+				return;
 			}
-			return val;
+			emit_imm(code, val);
 		}
 		else if (type == TK_DINT)
-		  return atoi(str);
-		else if (type == TK_REG) 
-			return (int)regname_to_val(str + 1);	
-		
-		Assert(0, "Neither int nor hex int nor reg!");
+			emit_imm(code, atoi(str));
+		else if (type == TK_REG) {
+			emit(code, TK_REG);
+			ExprInstr *instr = &code->code[code->nr_code - 1];
+			instr->reg = regname_to_ptr(str + 1, &instr->width);
+		}
+		else {
+			*success = false;
+			print_error("Syntex Error: Bad expression!");
+		}
 	}	
 
 	/* Throw away the parentheses */
 	else if (check_parentheses(p, q) == true){
-		return eval(p + 1, q - 1, success);
+		compile(p + 1, q - 1, code, success);
 	}
 
 	/* Process operators */
@@ -344,92 +366,152 @@ static int eval(int p, int q, bool *success) {
 		if (pos < 0) {
 			*success  = false;
 			print_error("Syntex Error: Fail to find dominant operator!");
-			return -1;
+			return;
 		}
 
 		int op = tokens[pos].type;
-		/* Process binary operator */
 		if (is_binary_operator(op)) {
-			int lval = eval(p, pos - 1, success),
-					rval = eval(pos + 1, q, success);
-			if (!(*success)) 
-				return -1;
-		
-			switch (op) {
-				case TK_OR:  return lval || rval;
-				case TK_AND: return lval && rval;
-				case TK_BOR: return lval |  rval;
-				case TK_BXOR:return lval ^  rval;
-				case TK_BAND:return lval &  rval;
-				case TK_EQ:  return lval == rval;
-				case TK_NEQ: return lval != rval;
-				case TK_LE:  return lval <= rval;
-				case TK_GE:  return lval >= rval;
-				case TK_L:   return lval <  rval;
-				case TK_G:	 return lval >  rval;						 
-				case TK_ADD: return lval +  rval;
-				case TK_SUB: return lval -  rval;
-				case TK_MUL: return lval *  rval;
-				case TK_DIV:
-					if (rval == 0) {
-						*success = false;
-						print_error("Divisor Error: Divisor is zero!");
-						return -1;
-					} 
-					return lval / rval;
-				case TK_MOD:
-					if (rval == 0) {
-						*success = false;
-						print_error("Mod Error: mod is zero!");
-						return -1;
-					} 
-					return lval % rval;
-				default:
-					assert(0);
+			compile(p, pos - 1, code, success);
+			compile(pos + 1, q, code, success);
+		}
+		else if (is_unary_operator(op)) 
+			compile(pos + 1, q, code, success);
+		else
+			Assert(0, "Neither binary operator nor unary operator!");
+
+		if (*success)
+			emit(code, op);
+	}
+}
+
+/* Evaluate the first `nr_code' instructions of `code'. */
+static uint32_t run(const ExprCode *code, int nr_code, bool *success) {
+	int stack[EXPR_MAX_CODE];
+	int top = 0, i;
+
+	for (i = 0; i < nr_code; ++i) {
+		const ExprInstr *instr = &code->code[i];
+		int op = instr->op;
+
+		if (op == TK_DINT) {
+			stack[top++] = instr->imm;
+			continue;
+		}
+		if (op == TK_REG) {
+			switch (instr->width) {
+				case 4: stack[top++] = *(const uint32_t *)instr->reg; break;
+				case 2: stack[top++] = *(const uint16_t *)instr->reg; break;
+				default:stack[top++] = *(const uint8_t *)instr->reg; break;
 			}
+			continue;
 		}
 
 		/* Process unary operator */
-		else if (is_unary_operator(op)) {
-			int rval = eval(pos + 1, q, success);
-			if (!(*success)) 
-				return -1;
-			
-			vaddr_t addr;
-			uint32_t mem_val;
-
+		if (is_unary_operator(op)) {
+			int rval = stack[top - 1];
 			switch (op) {
-				case TK_BNOT: return ~rval;
-				case TK_NOT:  return !rval;
-				case TK_NEG:  return -rval;
-				case TK_DEREF:
-					addr = rval;
-					mem_val = vaddr_read(addr, 4);
-					return (int)mem_val;					
+				case TK_BNOT: rval = ~rval; break;
+				case TK_NOT:  rval = !rval; break;
+				case TK_NEG:  rval = -rval; break;
+				case TK_DEREF:rval = (int)vaddr_read(rval, 4); break;
 				default:
 					assert(0);
 			}
+			stack[top - 1] = rval;
+			continue;
 		}
-		else
-			Assert(0, "Neither binary operator nor unary operator!");
+
+		/* Process binary operator */
+		int lval = stack[top - 2], rval = stack[top - 1];
+		top--;
+		switch (op) {
+			case TK_OR:  lval = lval || rval; break;
+			case TK_AND: lval = lval && rval; break;
+			case TK_BOR: lval = lval |  rval; break;
+			case TK_BXOR:lval = lval ^  rval; break;
+			case TK_BAND:lval = lval &  rval; break;
+			case TK_EQ:  lval = lval == rval; break;
+			case TK_NEQ: lval = lval != rval; break;
+			case TK_LE:  lval = lval <= rval; break;
+			case TK_GE:  lval = lval >= rval; break;
+			case TK_L:   lval = lval <  rval; break;
+			case TK_G:	 lval = lval >  rval; break;
+			case TK_ADD: lval = lval +  rval; break;
+			case TK_SUB: lval = lval -  rval; break;
+			case TK_MUL: lval = lval *  rval; break;
+			case TK_DIV:
+				if (rval == 0) {
+					*success = false;
+					print_error("Divisor Error: Divisor is zero!");
+					return 0;
+				} 
+				lval = lval / rval;
+				break;
+			case TK_MOD:
+				if (rval == 0) {
+					*success = false;
+					print_error("Mod Error: mod is zero!");
+					return 0;
+				} 
+				lval = lval % rval;
+				break;
+			default:
+				assert(0);
+		}
+		stack[top - 1] = lval;
 	}
+
+	*success = true;
+	return stack[0];
 }
 
-uint32_t expr(char *e, bool *success) {
+/* Compile an expression into postfix code, which can be evaluated
+ * by expr_run() many times without parsing the expression again.
+ */
+bool expr_compile(char *e, ExprCode *code) {
   if (!make_token(e)) {
-    *success = false;
 		print_error("Error: Fail to make tokens!");
-    return 0;
+    return false;
   }
 
 	if (!parentheses_are_matched(0, nr_token - 1)) {
-		*success = false;
 		print_error("Syntex Error: Parentheses are not matched!");
-		return 0;
+		return false;
 	} 
 
 	parse_special_token();
 
-	*success = true;
-	return eval(0, nr_token - 1, success);
+	bool success = true;
+	code->nr_code = 0;
+	compile(0, nr_token - 1, code, &success);
+	return success;
+}
+
+uint32_t expr_run(const ExprCode *code, bool *success) {
+	return run(code, code->nr_code, success);
+}
+
+/* Check whether the expression is `*ADDR' where ADDR only consists
+ * of constants. If so, return the value of ADDR by `addr'.
+ */
+bool expr_is_const_deref(const ExprCode *code, vaddr_t *addr) {
+	int i, n = code->nr_code - 1;
+	if (n < 1 || code->code[n].op != TK_DEREF)
+		return false;
+	for (i = 0; i < n; ++i)
+		if (code->code[i].op == TK_REG || code->code[i].op == TK_DEREF)
+			return false;
+
+	bool success;
+	*addr = run(code, n, &success);
+	return success;
+}
+
+uint32_t expr(char *e, bool *success) {
+	ExprCode code;
+	if (!expr_compile(e, &code)) {
+		*success = false;
+		return 0;
+	}
+	return expr_run(&code, success);
 }
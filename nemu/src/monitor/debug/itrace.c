@@ -0,0 +1,75 @@
+#include "nemu.h"
+#include "cpu/icache.h"
+#include "monitor/itrace.h"
+
+typedef struct {
+  vaddr_t eip;
+  uint8_t len;
+  uint8_t instr[INSTR_MAX_LEN];
+} ITraceEntry;
+
+#ifdef DEBUG
+bool itrace_enable = true;
+#else
+bool itrace_enable = false;
+#endif
+
+static ITraceEntry itrace[ITRACE_SIZE];
+static uint32_t itrace_tail = 0;   // number of entries ever recorded
+
+/* the bytes are the ones fetched when the instruction is decoded,
+ * so they are not read from the memory again */
+static void fill_entry(ITraceEntry *e, vaddr_t eip, int len, const uint8_t *instr) {
+  if (len > INSTR_MAX_LEN) { len = INSTR_MAX_LEN; }
+  e->eip = eip;
+  e->len = len;
+  memcpy(e->instr, instr, len);
+}
+
+/* Record the instruction of `len' bytes at `eip' which has just been executed. */
+void itrace_record(vaddr_t eip, int len, const uint8_t *instr) {
+  fill_entry(&itrace[itrace_tail & (ITRACE_SIZE - 1)], eip, len, instr);
+  itrace_tail ++;
+}
+
+static void print_entry(const ITraceEntry *e) {
+  char buf[128], *p = buf;
+  int i;
+  p += sprintf(p, "%8x:   ", e->eip);
+  for (i = 0; i < e->len; i ++) {
+    p += sprintf(p, "%02x ", e->instr[i]);
+  }
+
+  /* the name of the execution helper is taken from the instruction
+   * cache, which is likely to still hold recent instructions */
+  ICacheEntry *ic = icache_lookup(e->eip);
+  const char *name = (ic != NULL ? ic->instr.name : "?");
+  printf("%-50s%s\n", buf, name);
+}
+
+/* Print the instruction of `len' bytes at `eip'. */
+void itrace_print(vaddr_t eip, int len, const uint8_t *instr) {
+  ITraceEntry e;
+  fill_entry(&e, eip, len, instr);
+  print_entry(&e);
+}
+
+/* Print the last `n' instructions recorded, oldest first. */
+void itrace_dump(int n) {
+  uint32_t nr_valid = (itrace_tail < ITRACE_SIZE ? itrace_tail : ITRACE_SIZE);
+  if (n < 0 || n > nr_valid) { n = nr_valid; }
+
+  printf("last %d instructions:\n", n);
+  uint32_t i;
+  for (i = itrace_tail - n; i != itrace_tail; i ++) {
+    print_entry(&itrace[i & (ITRACE_SIZE - 1)]);
+  }
+}
+
+/* called by Assert() before aborting */
+void itrace_assert_fail(void) {
+  if (itrace_enable && itrace_tail != 0) {
+    fflush(stdout);
+    itrace_dump(ITRACE_DUMP_DEFAULT);
+  }
+}
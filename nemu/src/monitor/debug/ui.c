@@ -1,7 +1,11 @@
 #include "monitor/monitor.h"
 #include "monitor/expr.h"
 #include "monitor/watchpoint.h"
+#include "monitor/prof.h"
+#include "monitor/itrace.h"
+#include "monitor/snapshot.h"
 #include "nemu.h"
+#include "cpu/rtl.h"
 
 #include <stdlib.h>
 #include <readline/readline.h>
@@ -67,6 +71,7 @@ static int cmd_info(char *args) {
 			for (i = R_EAX; i <= R_EDI; i++)
 				printf("%s\t0x%08x\t%10d\n", regsl[i], reg_l(i), reg_l(i));
 			printf("%s\t0x%08x\t%10d\n", "eip", cpu.eip, cpu.eip);
+			rtl_eval_eflags();
 			printf("[OF IF SF ZF CF] = [%d %d %d %d %d]\n", 
 			       cpu.OF, cpu.IF, cpu.SF, cpu.ZF, cpu.CF);
 			break;
@@ -156,6 +161,80 @@ static int cmd_d(char *args) {
 	return 0;	
 }
 
+static int cmd_prof(char *args) {
+	char *arg = strtok(NULL, " ");
+	if (!arg) {
+		prof_report(20);
+		return 0;
+	}
+
+	if (strcmp(arg, "on") == 0)
+		prof_enable = true;
+	else if (strcmp(arg, "off") == 0)
+		prof_enable = false;
+	else if (strcmp(arg, "dump") == 0) {
+		char *file = strtok(NULL, " ");
+		if (!file && !(file = prof_file)) {
+			print_error("Argument Error: There should be a file name!");
+			return 0;
+		}
+		prof_dump(file);
+	}
+	else {
+		int N = atoi(arg);
+		if (N <= 0) {
+			print_error("Argument Error: Argument should be on, off, dump or a positive integer!");
+			return 0;
+		}
+		prof_report(N);
+	}
+	return 0;
+}
+
+static int cmd_itrace(char *args) {
+	char *arg = strtok(NULL, " ");
+	if (!arg) {
+		itrace_dump(ITRACE_DUMP_DEFAULT);
+		return 0;
+	}
+
+	if (strcmp(arg, "on") == 0)
+		itrace_enable = true;
+	else if (strcmp(arg, "off") == 0)
+		itrace_enable = false;
+	else {
+		int N = atoi(arg);
+		if (N <= 0) {
+			print_error("Argument Error: Argument should be on, off or a positive integer!");
+			return 0;
+		}
+		itrace_dump(N);
+	}
+	return 0;
+}
+
+static int cmd_save(char *args) {
+	char *file = strtok(NULL, " ");
+	if (!file) {
+		print_error("Argument Error: There should be a file name!");
+		return 0;
+	}
+
+	snapshot_save(file);
+	return 0;
+}
+
+static int cmd_load(char *args) {
+	char *file = strtok(NULL, " ");
+	if (!file) {
+		print_error("Argument Error: There should be a file name!");
+		return 0;
+	}
+
+	snapshot_load(file);
+	return 0;
+}
+
 static struct {
   char *name;
   char *description;
@@ -169,7 +248,11 @@ static struct {
 	{ "p", "Print the value of an expreesion", cmd_p },
 	{ "x", "Examine the memory", cmd_x },
 	{ "w", "Set a watchpoint", cmd_w },
-	{ "d", "Delete a watchpoint", cmd_d }
+	{ "d", "Delete a watchpoint", cmd_d },
+	{ "prof", "Print the N hottest instructions (prof [N]), switch profiling (prof on|off), or write the flat profile (prof dump [file])", cmd_prof },
+	{ "itrace", "Print the last N instructions executed (itrace [N]), or switch tracing (itrace on|off)", cmd_itrace },
+	{ "save", "Save the machine state to a snapshot file", cmd_save },
+	{ "load", "Load the machine state from a snapshot file", cmd_load }
 };
 
 #define NR_CMD (sizeof(cmd_table) / sizeof(cmd_table[0]))
@@ -1,5 +1,6 @@
 #include "monitor/watchpoint.h"
 #include "monitor/expr.h"
+#include "monitor/monitor.h"
 #include "cpu/reg.h"
 
 #define NR_WP 32
@@ -7,6 +8,8 @@
 static WP wp_pool[NR_WP];
 static WP *head, *free_;
 
+int nr_expr_wp = 0, nr_trap_wp = 0;
+
 static WP *new_wp() {
 	Assert(free_, "No extra space in wp_pool!");
 	WP *ret = free_;
@@ -35,14 +38,24 @@ bool insert_wp(char *expression) {
 	if (strlen(expression) >= 64) 
 		return false;
 	
+	ExprCode code;
+	if (!expr_compile(expression, &code))
+		return false;
+
 	bool success;
-	uint32_t val = expr(expression, &success);
+	uint32_t val = expr_run(&code, &success);
 	if (!success)
 		return false;
 
 	WP *wp = new_wp();
 	strcpy(wp->expr, expression);
 	wp->pre_val = val;
+	wp->code = code;
+	wp->is_trap = expr_is_const_deref(&code, &wp->addr);
+	if (wp->is_trap)
+		nr_trap_wp++;
+	else
+		nr_expr_wp++;
 	wp->next = head;
 	head = wp;
 	return true;
@@ -53,6 +66,10 @@ bool delete_wp(int N) {
 	while (cur != NULL) {
 		if (cur->NO == N) {
 			cur->expr[0] = '\0';
+			if (cur->is_trap)
+				nr_trap_wp--;
+			else
+				nr_expr_wp--;
 			if (!pre) 
 				head = cur->next;
 			else	
@@ -77,28 +94,53 @@ void print_all_wp() {
 		printf("%d\t%s\n", p->NO, p->expr);
 }
 
+static void report_hit(WP *p, uint32_t new_val) {
+	uint32_t pre_val = p->pre_val;
+	printf("Hit watchpoint %d: %s\n", p->NO, p->expr);
+	printf("at 0x%x\n", cpu.eip);
+	printf("Old value = %uU = %d = 0x%x\n",
+			   pre_val, (int)pre_val, pre_val);
+	printf("New value = %uU = %d = 0x%x\n",
+			   new_val, (int)new_val, new_val);
+	p->pre_val = new_val;
+}
+
+/* Check the watchpoints which are not write traps. */
 bool check_watchpoints() {
 	WP *p;
 	bool success;
 	bool hit_watchpoint = false;
-	uint32_t new_val, pre_val;
+	uint32_t new_val;
 
 	for (p = head; p != NULL; p = p->next) {
-		new_val = expr(p->expr, &success);
-		pre_val = p->pre_val;
+		if (p->is_trap)
+			continue;
+		new_val = expr_run(&p->code, &success);
 		if (!success)
 			return false;
-		if (new_val != pre_val) {
-			printf("Hit watchpoint %d: %s\n", p->NO, p->expr);
-			printf("at 0x%x\n", cpu.eip);
-			printf("Old value = %uU = %d = 0x%x\n",
-					   pre_val, (int)pre_val, pre_val);
-			printf("New value = %uU = %d = 0x%x\n",
-					   new_val, (int)new_val, new_val);
-			p->pre_val = new_val;
+		if (new_val != p->pre_val) {
+			report_hit(p, new_val);
 			hit_watchpoint = true;
 		}
 	}
 	return hit_watchpoint;
 }
 
+/* Called after the guest writes `len' bytes at `addr'.
+ * Stop NEMU if a watched value is changed.
+ */
+void wp_check_write(vaddr_t addr, int len) {
+	WP *p;
+	bool success;
+	uint32_t new_val;
+
+	for (p = head; p != NULL; p = p->next) {
+		if (!p->is_trap || addr + len <= p->addr || p->addr + 4 <= addr)
+			continue;
+		new_val = expr_run(&p->code, &success);
+		if (success && new_val != p->pre_val) {
+			report_hit(p, new_val);
+			nemu_state = NEMU_STOP;
+		}
+	}
+}
@@ -1,5 +1,7 @@
 #include "nemu.h"
 #include "monitor/monitor.h"
+#include "cpu/rtl.h"
+#include "memory/mmu.h"
 #include <unistd.h>
 #include <sys/prctl.h>
 #include <signal.h>
@@ -9,6 +11,7 @@
 
 bool gdb_connect_qemu(void);
 bool gdb_memcpy_to_qemu(uint32_t, void *, int);
+bool gdb_memcpy_from_qemu(uint32_t, void *, int);
 bool gdb_getregs(union gdb_regs *);
 bool gdb_setregs(union gdb_regs *);
 bool gdb_si(void);
@@ -16,9 +19,12 @@ void gdb_exit(void);
 
 static bool is_skip_qemu;
 static bool is_skip_nemu;
+static bool is_rep;
+static uint32_t rep_nr_step;
 
 void diff_test_skip_qemu() { is_skip_qemu = true; }
 void diff_test_skip_nemu() { is_skip_nemu = true; }
+void diff_test_rep(uint32_t nr_step) { is_rep = true; rep_nr_step = nr_step; }
 
 #define regcpy_from_nemu(regs) \
   do { \
@@ -118,85 +124,222 @@ void init_difftest(void) {
   }
 }
 
+/* QEMU is stepped along with NEMU, but the states are only compared
+ * after BATCH_SIZE steps, or before an instruction QEMU can not run.
+ * NEMU at the last comparison is kept as a checkpoint. If the states
+ * differ, both of them go back to the checkpoint, and the instruction
+ * making the difference is found by bisection.
+ */
+#define BATCH_SIZE 1024
+
+static CPU_state ckpt_cpu;        // NEMU at the checkpoint
+static union gdb_regs ckpt_regs;  // QEMU at the checkpoint
+static CPU_state prev_cpu;        // NEMU before the last instruction
+static uint32_t nr_instr;         // NEMU instructions since the checkpoint
+static uint32_t nr_step;          // QEMU steps not yet done
+static uint32_t last_nr_step;     // QEMU steps of the last instruction
+static bool is_replay;
+
+static void difftest_checkpoint(union gdb_regs *r) {
+  ckpt_cpu = cpu;
+  prev_cpu = cpu;
+  ckpt_regs = *r;
+  nr_instr = 0;
+  pmem_checkpoint();
+}
+
+static void difftest_rollback(void) {
+  cpu = ckpt_cpu;
+  rtl_set_eflags(&ckpt_cpu.eflags);
+  prev_cpu = cpu;
+  nr_instr = 0;
+  nr_step = 0;
+  last_nr_step = 1;
+  pmem_rollback();
+
+  // the pages written by NEMU are also written back to QEMU
+  bool ok = gdb_setregs(&ckpt_regs);
+  const uint32_t *pfn;
+  const uint8_t *old;
+  uint32_t i, nr_page = pmem_dirty_pages(&pfn, &old);
+  for (i = 0; i < nr_page; i ++) {
+    ok &= gdb_memcpy_to_qemu(pfn[i] * PAGE_SIZE, guest_to_host(pfn[i] * PAGE_SIZE), PAGE_SIZE);
+  }
+  assert(ok == 1);
+}
+
+#define check_reg(reg) \
+  if (r->reg != c->reg) { \
+    same = false; \
+    if (verbose) { \
+      Log("Detect difference at eip = 0x%x:\tcpu." str(reg) " = 0x%x\tr." str(reg) " = 0x%x", \
+          eip, c->reg, r->reg); \
+    } \
+  }
+
+/* Do the steps of QEMU not done yet, and compare its registers in `r'
+ * and the pages written since the checkpoint with NEMU in `c'. */
+static bool difftest_check(const CPU_state *c, union gdb_regs *r, uint32_t eip, bool verbose) {
+  for (; nr_step > 0; nr_step --) {
+    gdb_si();
+  }
+  gdb_getregs(r);
+
+  bool same = true;
+  check_reg(eax);
+  check_reg(ecx);
+  check_reg(edx);
+  check_reg(ebx);
+  check_reg(esp);
+  check_reg(ebp);
+  check_reg(esi);
+  check_reg(edi);
+  check_reg(eip);
+
+  // only the bytes NEMU has changed are compared, since QEMU may have
+  // its own data in the rest of the page, e.g. the MBR
+  static uint8_t page[PAGE_SIZE];
+  const uint32_t *pfn;
+  const uint8_t *old;
+  uint32_t i, nr_page = pmem_dirty_pages(&pfn, &old);
+  for (i = 0; i < nr_page; i ++, old += PAGE_SIZE) {
+    paddr_t addr = pfn[i] * PAGE_SIZE;
+    const uint8_t *host = guest_to_host(addr);
+    bool ok = gdb_memcpy_from_qemu(addr, page, PAGE_SIZE);
+    assert(ok == 1);
+    int off;
+    for (off = 0; off < PAGE_SIZE; off ++) {
+      if (page[off] != host[off] && host[off] != old[off]) { break; }
+    }
+    if (off < PAGE_SIZE) {
+      same = false;
+      if (verbose) {
+        Log("Detect difference at eip = 0x%x:\tpmem[0x%x] = 0x%02x\tqemu[0x%x] = 0x%02x",
+            eip, addr + off, host[off], addr + off, page[off]);
+      }
+    }
+  }
+
+  return same;
+}
+
+/* Run NEMU from the checkpoint for at least `n' instructions, but not
+ * to stop between QEMU steps. Return the number of instructions run. */
+static uint32_t difftest_replay(uint32_t n) {
+  void exec_wrapper(bool);
+  void raise_page_fault(void);
+
+  // page faults are raised here instead of in cpu_exec()
+  jmp_buf *cpu_exec_jmp = pf_jmp;
+  jmp_buf pf_buf;
+  if (setjmp(pf_buf) != 0) {
+    pf_jmp = NULL;
+    raise_page_fault();
+  }
+  pf_jmp = &pf_buf;
+
+  while ((nr_instr < n || last_nr_step == 0) && nemu_state == NEMU_RUNNING) {
+    exec_wrapper(false);
+  }
+  pf_jmp = cpu_exec_jmp;
+  return nr_instr;
+}
+
+/* NEMU and QEMU differ after `n' instructions from the checkpoint. */
+static void difftest_bisect(uint32_t n) {
+  union gdb_regs r;
+  uint32_t lo = 0, hi = n;
+  Log("Detect difference in %u instructions from eip = 0x%x", n, ckpt_cpu.eip);
+
+  // NEMU may have stopped at the last instruction, e.g. nemu_trap
+  is_replay = true;
+  nemu_state = NEMU_RUNNING;
+  while (hi - lo > 1) {
+    difftest_rollback();
+    uint32_t m = difftest_replay((hi - lo) / 2);
+    if (m == 0 || m >= hi - lo) { break; }
+    if (difftest_check(&cpu, &r, 0, false)) {
+      difftest_checkpoint(&r);
+      lo += m;
+    }
+    else {
+      hi = lo + m;
+    }
+  }
+
+  // run the instructions making the difference again to show it
+  difftest_rollback();
+  uint32_t eip = cpu.eip;
+  difftest_replay(hi - lo);
+  if (difftest_check(&cpu, &r, eip, true)) {
+    Log("The difference is not found again from eip = 0x%x", eip);
+  }
+  is_replay = false;
+
+  nemu_state = NEMU_END;
+}
+
 void init_qemu_reg() {
   union gdb_regs r;
   gdb_getregs(&r);
   regcpy_from_nemu(r);
   bool ok = gdb_setregs(&r);
   assert(ok == 1);
+  difftest_checkpoint(&r);
 }
 
 void difftest_step(uint32_t eip) {
-  union gdb_regs r;
-  bool diff = false;
-
-  if (is_skip_nemu) {
-    is_skip_nemu = false;
-    return;
-  }
+  rtl_eval_eflags();
 
   if (is_skip_qemu) {
-    // to skip the checking of an instruction, just copy the reg state to qemu
-    gdb_getregs(&r);
+    is_skip_qemu = false;
+    if (is_replay) { return; }
+
+    // check the steps before this instruction, and copy the reg state to qemu
+    union gdb_regs r;
+    if (!difftest_check(&prev_cpu, &r, prev_cpu.eip, false)) {
+      difftest_bisect(nr_instr);
+      return;
+    }
     regcpy_from_nemu(r);
     gdb_setregs(&r);
-    is_skip_qemu = false;
+    difftest_checkpoint(&r);
     return;
   }
 
-  gdb_si();
-  gdb_getregs(&r);
-
-  // Check the registers state with QEMU.
-  // Set `diff` as `true` if they are not the same.
-  if (r.eax != cpu.eax) {
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.eax = 0x%x\tr.eax = 0x%x)",
-           eip, cpu.eax, r.eax);     
-  }
-  if (r.ecx != cpu.ecx){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.ecx = 0x%x\tr.ecx = 0x%x)",
-           eip, cpu.ecx, r.ecx);     
-  }
-  if (r.edx != cpu.edx){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.edx = 0x%x\tr.edx = 0x%x)",
-           eip, cpu.edx, r.edx);
-  }
-  if (r.ebx != cpu.ebx){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.ebx = 0x%x\tr.ebx = 0x%x)",
-           eip, cpu.ebx, r.ebx);
-  }
-  if (r.esp != cpu.esp){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.esp = 0x%x\tr.esp = 0x%x)",
-           eip, cpu.esp, r.esp);
-  }
-  if (r.ebp != cpu.ebp){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.ebp = 0x%x\tr.ebp = 0x%x)",
-           eip, cpu.ebp, r.ebp);
-  }
-  if (r.esi != cpu.esi){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.esi = 0x%x\tr.esi = 0x%x)",
-           eip, cpu.esi, r.esi);
-  }
-  if (r.edi != cpu.edi){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.edi = 0x%x\tr.edi = 0x%x)",
-           eip, cpu.edi, r.edi);
+  // QEMU steps over `int' with the next instruction together,
+  // and over a rep instruction one element at a time
+  last_nr_step = 1;
+  if (is_skip_nemu) {
+    is_skip_nemu = false;
+    last_nr_step = 0;
   }
-  if (r.eip != cpu.eip){
-    diff = true;
-    Log("Detect difference at eip = 0x%x:\tcpu.eip = 0x%x\tr.eip = 0x%x)",
-           eip, cpu.eip, r.eip);
+  else if (is_rep) {
+    is_rep = false;
+    last_nr_step = (rep_nr_step == 0 ? 1 : rep_nr_step);
   }
-    
+  nr_instr ++;
+  nr_step += last_nr_step;
+  prev_cpu = cpu;
 
-  if (diff) {
-    nemu_state = NEMU_END;
+  if (!is_replay && last_nr_step != 0 && nr_step >= BATCH_SIZE) {
+    union gdb_regs r;
+    if (difftest_check(&cpu, &r, eip, false)) {
+      difftest_checkpoint(&r);
+    }
+    else {
+      difftest_bisect(nr_instr);
+    }
   }
 }
+
+/* The instruction after prev_cpu is aborted by a page fault, which QEMU
+ * raises in one step. A rep instruction has done its elements before
+ * the fault in one step each. */
+void difftest_fault(bool is_rep_instr) {
+  rtl_eval_eflags();
+  last_nr_step = 1 + (is_rep_instr ? prev_cpu.ecx - cpu.ecx : 0);
+  nr_instr ++;
+  nr_step += last_nr_step;
+  prev_cpu = cpu;
+}
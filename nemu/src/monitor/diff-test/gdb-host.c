@@ -11,6 +11,21 @@ bool gdb_connect_qemu(void) {
     usleep(1);
   }
 
+  // packets are not acknowledged over TCP, saving a round trip for each
+  if (gdb_start_noack(conn)[0] == '\0') {
+    Log("QEMU does not support the no-ack mode");
+  }
+
+  // memory is accessed by physical addresses, the same as pmem
+  static const char phy[] = "Qqemu.PhyMemMode:1";
+  gdb_send(conn, (const uint8_t *)phy, sizeof(phy) - 1);
+  size_t size;
+  uint8_t *reply = gdb_recv(conn, &size);
+  if (strcmp((const char *)reply, "OK") != 0) {
+    Log("QEMU does not support accessing physical memory, and paging should not be enabled");
+  }
+  free(reply);
+
   return true;
 }
 
@@ -18,12 +33,9 @@ static bool gdb_memcpy_to_qemu_small(uint32_t dest, void *src, int len) {
   char *buf = malloc(len * 2 + 128);
   assert(buf != NULL);
   int p = sprintf(buf, "M0x%x,%x:", dest, len);
-  int i;
-  for (i = 0; i < len; i ++) {
-    p += sprintf(buf + p, "%c%c", hex_encode(((uint8_t *)src)[i] >> 4), hex_encode(((uint8_t *)src)[i] & 0xf));
-  }
+  gdb_encode_hex_buf((uint8_t *)buf + p, src, len);
 
-  gdb_send(conn, (const uint8_t *)buf, strlen(buf));
+  gdb_send(conn, (const uint8_t *)buf, p + len * 2);
   free(buf);
 
   size_t size;
@@ -47,25 +59,44 @@ bool gdb_memcpy_to_qemu(uint32_t dest, void *src, int len) {
   return ok;
 }
 
+static bool gdb_memcpy_from_qemu_small(uint32_t src, void *dest, int len) {
+  char buf[32];
+  int p = sprintf(buf, "m0x%x,%x", src, len);
+  gdb_send(conn, (const uint8_t *)buf, p);
+
+  size_t size;
+  uint8_t *reply = gdb_recv(conn, &size);
+  bool ok = size == len * 2 && gdb_decode_hex_buf(dest, reply, len) == len;
+  free(reply);
+
+  return ok;
+}
+
+bool gdb_memcpy_from_qemu(uint32_t src, void *dest, int len) {
+  const int mtu = 1500;
+  bool ok = true;
+  while (len > mtu) {
+    ok &= gdb_memcpy_from_qemu_small(src, dest, mtu);
+    src += mtu;
+    dest += mtu;
+    len -= mtu;
+  }
+  ok &= gdb_memcpy_from_qemu_small(src, dest, len);
+  return ok;
+}
+
 bool gdb_getregs(union gdb_regs *r) {
   gdb_send(conn, (const uint8_t *)"g", 1);
   size_t size;
   uint8_t *reply = gdb_recv(conn, &size);
 
-  int i;
-  uint8_t *p = reply;
-  uint8_t c;
-  for (i = 0; i < sizeof(union gdb_regs) / sizeof(uint32_t); i ++) {
-    c = p[8];
-    p[8] = '\0';
-    r->array[i] = gdb_decode_hex_str(p);
-    p[8] = c;
-    p += 8;
-  }
+  // the registers are sent in the target byte order, the same as the host
+  size_t len = size / 2 < sizeof(*r) ? size / 2 : sizeof(*r);
+  bool ok = gdb_decode_hex_buf((uint8_t *)r, reply, len) == len;
 
   free(reply);
 
-  return true;
+  return ok;
 }
 
 bool gdb_setregs(union gdb_regs *r) {
@@ -73,15 +104,9 @@ bool gdb_setregs(union gdb_regs *r) {
   char *buf = malloc(len * 2 + 128);
   assert(buf != NULL);
   buf[0] = 'G';
+  gdb_encode_hex_buf((uint8_t *)buf + 1, (const uint8_t *)r, len);
 
-  void *src = r;
-  int p = 1;
-  int i;
-  for (i = 0; i < len; i ++) {
-    p += sprintf(buf + p, "%c%c", hex_encode(((uint8_t *)src)[i] >> 4), hex_encode(((uint8_t *)src)[i] & 0xf));
-  }
-
-  gdb_send(conn, (const uint8_t *)buf, strlen(buf));
+  gdb_send(conn, (const uint8_t *)buf, len * 2 + 1);
   free(buf);
 
   size_t size;
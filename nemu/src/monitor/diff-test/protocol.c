@@ -68,12 +68,35 @@ uint64_t gdb_decode_hex_str(uint8_t *bytes) {
     bytes += 2;
     weight *= 16 * 16;
   }
+
   return value;
 }
 
+// encode `len' bytes of `src' as hex digits, without a terminating NUL
+void gdb_encode_hex_buf(uint8_t *hex, const uint8_t *src, size_t len) {
+  static const char digits[] = "0123456789abcdef";
+  size_t i;
+  for (i = 0; i < len; i ++) {
+    hex[2 * i] = digits[src[i] >> 4];
+    hex[2 * i + 1] = digits[src[i] & 0xf];
+  }
+}
+
+// decode up to `len' bytes from hex digits, and return the number decoded
+size_t gdb_decode_hex_buf(uint8_t *dest, const uint8_t *hex, size_t len) {
+  size_t i;
+  for (i = 0; i < len; i ++) {
+    uint16_t byte = gdb_decode_hex(hex[2 * i], hex[2 * i + 1]);
+    if (byte == UINT16_MAX)
+      break;
+    dest[i] = byte;
+  }
+  return i;
+}
+
 
 static struct gdb_conn* gdb_begin(int fd) {
-  struct gdb_conn *conn = calloc(1, sizeof(struct gdb_conn *));
+  struct gdb_conn *conn = calloc(1, sizeof(struct gdb_conn));
   if (conn == NULL)
     err(1, "calloc");
 
@@ -34,6 +34,8 @@ struct gdb_conn;
 
 uint16_t gdb_decode_hex(uint8_t msb, uint8_t lsb);
 uint64_t gdb_decode_hex_str(uint8_t *bytes);
+void gdb_encode_hex_buf(uint8_t *hex, const uint8_t *src, size_t len);
+size_t gdb_decode_hex_buf(uint8_t *dest, const uint8_t *hex, size_t len);
 
 uint8_t hex_encode(uint8_t digit);
 
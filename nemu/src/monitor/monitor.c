@@ -1,5 +1,13 @@
 #include "nemu.h"
+#include "cpu/bb.h"
+#include "memory/mmu.h"
+#include "monitor/prof.h"
+#include "monitor/snapshot.h"
+#include "device/device.h"
 #include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <elf.h>
 
 #define ENTRY_START 0x100000
 
@@ -7,6 +15,7 @@ void init_difftest();
 void init_regex();
 void init_wp_pool();
 void init_device();
+void init_frame_map();
 
 void reg_test();
 void init_qemu_reg();
@@ -15,7 +24,11 @@ bool gdb_memcpy_to_qemu(uint32_t, void *, int);
 FILE *log_fp = NULL;
 static char *log_file = NULL;
 static char *img_file = NULL;
+static char *snapshot_load_file = NULL;
+static char *snapshot_save_file = NULL;
 static int is_batch_mode = false;
+static uint32_t pmem_size_arg = PMEM_SIZE;
+static vaddr_t entry_start = ENTRY_START;
 
 static inline void init_log() {
 #ifdef DEBUG
@@ -51,57 +64,127 @@ static inline int load_default_img() {
   return sizeof(img);
 }
 
+/* Load the PT_LOAD segments to their physical addresses. The bss is
+ * left as it is, since pmem is all zero at startup. */
+static inline vaddr_t load_elf(int fd) {
+  Elf32_Ehdr eh;
+  Assert(pread(fd, &eh, sizeof(eh), 0) == sizeof(eh) &&
+      eh.e_ident[EI_CLASS] == ELFCLASS32 && eh.e_machine == EM_386,
+      "'%s' is not an i386 ELF executable", img_file);
+
+  int i;
+  for (i = 0; i < eh.e_phnum; i ++) {
+    Elf32_Phdr ph;
+    Assert(pread(fd, &ph, sizeof(ph), eh.e_phoff + i * eh.e_phentsize) == sizeof(ph),
+        "Can not read the program headers of '%s'", img_file);
+    if (ph.p_type != PT_LOAD) continue;
+
+    Assert(ph.p_filesz <= ph.p_memsz && ph.p_paddr + ph.p_memsz <= pmem_size &&
+        pmem_map_file(ph.p_paddr, fd, ph.p_offset, ph.p_filesz),
+        "Can not load the segment at 0x%08x of '%s'", ph.p_paddr, img_file);
+    pmem_touch(ph.p_paddr, ph.p_memsz);
+  }
+  return eh.e_entry;
+}
+
+/* The image is mapped to pmem instead of being read, so that large
+ * images (e.g. with a big ramdisk) are loaded at once. */
 static inline void load_img() {
-  long size;
   if (img_file == NULL) {
-    size = load_default_img();
+    long size = load_default_img();
+    pmem_touch(ENTRY_START, size);
+    return;
   }
-  else {
-    int ret;
-
-    FILE *fp = fopen(img_file, "rb");
-    Assert(fp, "Can not open '%s'", img_file);
-
-    Log("The image is %s", img_file);
 
-    fseek(fp, 0, SEEK_END);
-    size = ftell(fp);
+  int fd = open(img_file, O_RDONLY);
+  Assert(fd >= 0, "Can not open '%s'", img_file);
 
-    fseek(fp, 0, SEEK_SET);
-    ret = fread(guest_to_host(ENTRY_START), size, 1, fp);
-    assert(ret == 1);
+  Log("The image is %s", img_file);
 
-    fclose(fp);
+  char magic[SELFMAG];
+  if (pread(fd, magic, SELFMAG, 0) == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0) {
+    entry_start = load_elf(fd);
   }
+  else {
+    off_t size = lseek(fd, 0, SEEK_END);
+    Assert(size >= 0 && ENTRY_START + size <= pmem_size, "The image is too large for the physical memory");
+    Assert(pmem_map_file(ENTRY_START, fd, 0, size), "Can not load '%s'", img_file);
+  }
+
+  close(fd);
+}
 
 #ifdef DIFF_TEST
-  gdb_memcpy_to_qemu(ENTRY_START, guest_to_host(ENTRY_START), size);
-#endif
+/* Copy the touched pages of pmem to QEMU, a run of pages at a time. */
+static inline void sync_pmem_to_qemu() {
+  uint32_t i, j, nr_page = pmem_size / PAGE_SIZE;
+  for (i = 0; i < nr_page; i = j) {
+    for (j = i; j < nr_page && pmem_touched[j]; j ++);
+    if (j > i) {
+      gdb_memcpy_to_qemu(i * PAGE_SIZE, guest_to_host(i * PAGE_SIZE), (j - i) * PAGE_SIZE);
+    }
+    else {
+      j ++;
+    }
+  }
 }
+#endif
 
 static inline void restart() {
   /* Set the initial instruction pointer. */
-  cpu.eip = ENTRY_START;
+  cpu.eip = entry_start;
   cpu.eflags = 0x2;
   cpu.cs = 8;
   cpu.cr0 = 0x60000011;
+  tlb_flush();
 #ifdef DIFF_TEST
+  sync_pmem_to_qemu();
   init_qemu_reg();
 #endif
 }
 
 static inline void parse_args(int argc, char *argv[]) {
   int o;
-  while ( (o = getopt(argc, argv, "-bl:")) != -1) {
+  while ( (o = getopt(argc, argv, "-bl:e:p:m:L:S:HF:D:K:")) != -1) {
     switch (o) {
       case 'b': is_batch_mode = true; break;
       case 'l': log_file = optarg; break;
+      case 'e':
+                if (strcmp(optarg, "block") == 0) bb_engine = true;
+                else if (strcmp(optarg, "interp") == 0) bb_engine = false;
+                else panic("Unknown execution engine '%s'", optarg);
+                break;
+      case 'p': prof_enable = true; prof_file = optarg; break;
+      case 'm':
+                {
+                  unsigned long mb = strtoul(optarg, NULL, 0);
+                  if (mb == 0 || mb > (PMEM_MAX_SIZE >> 20)) panic("Invalid memory size '%s' MiB", optarg);
+                  pmem_size_arg = mb << 20;
+                  if (pmem_size_arg < PMEM_SIZE) {
+                    Log("AM images assume %d MiB of memory, and abort NEMU beyond %lu MiB",
+                        PMEM_SIZE >> 20, mb);
+                  }
+                }
+                break;
+      case 'L': snapshot_load_file = optarg; break;
+      case 'S': snapshot_save_file = optarg; break;
+      case 'H': device_headless = true; break;
+      case 'F': vga_checksum_file = optarg; break;
+      case 'D':
+                {
+                  char *file;
+                  vga_dump_frame = strtoul(optarg, &file, 0);
+                  if (*file != ':' || file[1] == '\0') panic("Usage: -D frame:file");
+                  vga_dump_file = file + 1;
+                }
+                break;
+      case 'K': key_script_file = optarg; break;
       case 1:
                 if (img_file != NULL) Log("too much argument '%s', ignored", optarg);
                 else img_file = optarg;
                 break;
       default:
-                panic("Usage: %s [-b] [-l log_file] [img_file]", argv[0]);
+                panic("Usage: %s [-b] [-l log_file] [-e interp|block] [-p prof_file] [-m mem_MiB] [-L snapshot] [-S snapshot] [-H] [-F checksum_file] [-D frame:ppm_file] [-K key_script] [img_file]", argv[0]);
     }
   }
 }
@@ -123,7 +206,8 @@ int init_monitor(int argc, char *argv[]) {
   init_difftest();
 #endif
 
-  /* Load the image to memory. */
+  /* Allocate the physical memory and load the image to it. */
+  init_pmem(pmem_size_arg);
   load_img();
 
   /* Initialize this virtual computer system. */
@@ -135,11 +219,24 @@ int init_monitor(int argc, char *argv[]) {
   /* Initialize the watchpoint pool. */
   init_wp_pool();
 
-  /* Initialize devices. */
+  /* Initialize the physical memory map and devices. */
+  init_frame_map();
   init_device();
 
+  /* Continue from a snapshot. */
+  if (snapshot_load_file != NULL) {
+    Assert(snapshot_load(snapshot_load_file), "Can not load snapshot '%s'", snapshot_load_file);
+  }
+
   /* Display welcome message. */
   welcome();
 
   return is_batch_mode;
 }
+
+void fini_monitor() {
+  /* Save the machine state before exiting. */
+  if (snapshot_save_file != NULL) {
+    snapshot_save(snapshot_save_file);
+  }
+}
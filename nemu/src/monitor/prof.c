@@ -0,0 +1,187 @@
+#include "nemu.h"
+#include "cpu/icache.h"
+#include "monitor/prof.h"
+#include <stdlib.h>
+#include <inttypes.h>
+
+#define PROF_INIT_SIZE 4096
+#define PROF_MAX_HELPER 256
+
+typedef struct {
+  vaddr_t eip;
+  uint32_t opcode;
+  const char *name;
+  uint64_t count;   // 0 for an empty slot
+} ProfEntry;
+
+bool prof_enable = false;
+char *prof_file = NULL;
+
+static uint64_t opcode_count[512];
+
+/* open addressing hash table of eips */
+static ProfEntry *prof_table = NULL;
+static uint32_t prof_size = 0;
+static uint32_t nr_entry = 0;
+
+static inline uint32_t prof_hash(vaddr_t eip) {
+  return (eip * 2654435761u) & (prof_size - 1);
+}
+
+static ProfEntry* prof_slot(vaddr_t eip) {
+  uint32_t i = prof_hash(eip);
+  while (prof_table[i].count != 0 && prof_table[i].eip != eip) {
+    i = (i + 1) & (prof_size - 1);
+  }
+  return &prof_table[i];
+}
+
+static void prof_resize(uint32_t size) {
+  ProfEntry *old_table = prof_table;
+  uint32_t old_size = prof_size;
+
+  prof_table = calloc(size, sizeof(ProfEntry));
+  Assert(prof_table != NULL, "Can not allocate the profile table");
+  prof_size = size;
+
+  uint32_t i;
+  for (i = 0; i < old_size; i ++) {
+    if (old_table[i].count != 0) {
+      *prof_slot(old_table[i].eip) = old_table[i];
+    }
+  }
+  free(old_table);
+}
+
+/* Count the execution of the instruction at `eip'. */
+void prof_record(vaddr_t eip, uint32_t opcode) {
+  opcode_count[opcode] ++;
+
+  if (nr_entry * 4 >= prof_size * 3) {
+    prof_resize(prof_size == 0 ? PROF_INIT_SIZE : prof_size * 2);
+  }
+
+  ProfEntry *p = prof_slot(eip);
+  if (p->count == 0) {
+    p->eip = eip;
+    p->opcode = opcode;
+    p->name = NULL;
+    nr_entry ++;
+  }
+  p->count ++;
+
+  if (p->name == NULL) {
+    /* the decoding result has just been put into the instruction cache */
+    ICacheEntry *e = icache_lookup(eip);
+    if (e != NULL) { p->name = e->instr.name; }
+  }
+}
+
+static int cmp_entry(const void *a, const void *b) {
+  uint64_t ca = ((const ProfEntry *)a)->count;
+  uint64_t cb = ((const ProfEntry *)b)->count;
+  return (ca < cb) - (ca > cb);
+}
+
+/* Return the profile entries sorted by count, which should be freed. */
+static ProfEntry* prof_sorted(void) {
+  ProfEntry *sorted = malloc((nr_entry + 1) * sizeof(ProfEntry));
+  Assert(sorted != NULL, "Can not allocate memory for sorting");
+
+  uint32_t i, n = 0;
+  for (i = 0; i < prof_size; i ++) {
+    if (prof_table[i].count != 0) { sorted[n ++] = prof_table[i]; }
+  }
+  qsort(sorted, n, sizeof(ProfEntry), cmp_entry);
+  return sorted;
+}
+
+static inline const char* helper_name(const char *name) {
+  return (name == NULL ? "?" : name);
+}
+
+static inline double percent(uint64_t count, uint64_t total) {
+  return (total == 0 ? 0.0 : 100.0 * count / total);
+}
+
+/* Print the `top' hottest eips, opcodes and execution helpers. */
+void prof_report(int top) {
+  uint64_t total = 0;
+  int i, j, n;
+  for (i = 0; i < 512; i ++) {
+    total += opcode_count[i];
+  }
+  printf("profile: %" PRIu64 " instructions, %u distinct eips\n", total, nr_entry);
+
+  /* eips */
+  ProfEntry *sorted = prof_sorted();
+  n = (nr_entry < top ? nr_entry : top);
+  printf("\n%-10s %14s %7s %6s  %s\n", "eip", "count", "%", "opcode", "helper");
+  for (i = 0; i < n; i ++) {
+    ProfEntry *p = &sorted[i];
+    printf("0x%08x %14" PRIu64 " %6.2f%% 0x%03x  %s\n", p->eip, p->count,
+        percent(p->count, total), p->opcode, helper_name(p->name));
+  }
+
+  /* opcodes */
+  static ProfEntry ops[512];
+  n = 0;
+  for (i = 0; i < 512; i ++) {
+    if (opcode_count[i] != 0) {
+      ops[n].opcode = i;
+      ops[n].count = opcode_count[i];
+      n ++;
+    }
+  }
+  qsort(ops, n, sizeof(ProfEntry), cmp_entry);
+  printf("\n%-10s %14s %7s\n", "opcode", "count", "%");
+  for (i = 0; i < n && i < top; i ++) {
+    printf("0x%03x      %14" PRIu64 " %6.2f%%\n", ops[i].opcode, ops[i].count, percent(ops[i].count, total));
+  }
+
+  /* execution helpers, gathered from the eips */
+  static ProfEntry helpers[PROF_MAX_HELPER];
+  n = 0;
+  for (i = 0; i < nr_entry; i ++) {
+    const char *name = helper_name(sorted[i].name);
+    for (j = 0; j < n; j ++) {
+      if (strcmp(helpers[j].name, name) == 0) { break; }
+    }
+    if (j == n) {
+      if (n == PROF_MAX_HELPER) { continue; }
+      helpers[n].name = name;
+      helpers[n].count = 0;
+      n ++;
+    }
+    helpers[j].count += sorted[i].count;
+  }
+  qsort(helpers, n, sizeof(ProfEntry), cmp_entry);
+  printf("\n%-10s %14s %7s\n", "helper", "count", "%");
+  for (i = 0; i < n && i < top; i ++) {
+    printf("%-10s %14" PRIu64 " %6.2f%%\n", helpers[i].name, helpers[i].count, percent(helpers[i].count, total));
+  }
+
+  free(sorted);
+}
+
+/* Write a flat profile with one line per eip, hottest first.
+ * The eips can be matched against the symbols of the guest ELF.
+ */
+void prof_dump(const char *file) {
+  FILE *fp = fopen(file, "w");
+  if (fp == NULL) {
+    Log("Can not open '%s' for the profile", file);
+    return;
+  }
+
+  ProfEntry *sorted = prof_sorted();
+  uint32_t i;
+  fprintf(fp, "# eip count opcode helper\n");
+  for (i = 0; i < nr_entry; i ++) {
+    ProfEntry *p = &sorted[i];
+    fprintf(fp, "0x%08x %" PRIu64 " 0x%03x %s\n", p->eip, p->count, p->opcode, helper_name(p->name));
+  }
+  free(sorted);
+  fclose(fp);
+  Log("Profile is written to %s", file);
+}
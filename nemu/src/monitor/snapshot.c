@@ -0,0 +1,223 @@
+#include "nemu.h"
+#include "cpu/rtl.h"
+#include "cpu/icache.h"
+#include "memory/mmu.h"
+#include "device/event.h"
+#include "monitor/monitor.h"
+#include "monitor/snapshot.h"
+#include <stdlib.h>
+
+#define SNAPSHOT_MAGIC "NEMUSNAP"
+#define SNAPSHOT_VERSION 3
+#define SECTION_NAME_LEN 8
+#define PAGE_END 0xffffffffu
+
+typedef struct {
+  const char *name;
+  void *addr;
+  size_t size;
+} Region;
+
+static Region regions[NR_SNAPSHOT_REGION];
+static int nr_region = 0;
+
+static void (*hooks[NR_SNAPSHOT_HOOK])(void);
+static int nr_hook = 0;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t pmem_size;
+} SnapshotHeader;
+
+/* Each section is a header followed by `size' bytes, except that the
+ * pmem section is a list of (page number, page) ended by PAGE_END. */
+typedef struct {
+  char name[SECTION_NAME_LEN];
+  uint32_t size;
+} SectionHeader;
+
+/* Register `size' bytes at `addr' to be saved in snapshots. */
+void snapshot_add_region(const char *name, void *addr, size_t size) {
+  assert(nr_region < NR_SNAPSHOT_REGION);
+  assert(strlen(name) < SECTION_NAME_LEN);
+  regions[nr_region].name = name;
+  regions[nr_region].addr = addr;
+  regions[nr_region].size = size;
+  nr_region ++;
+}
+
+/* Register `hook' to be called after a snapshot is loaded. */
+void snapshot_add_hook(void (*hook)(void)) {
+  assert(nr_hook < NR_SNAPSHOT_HOOK);
+  hooks[nr_hook ++] = hook;
+}
+
+static inline bool is_gzip(const char *file) {
+  size_t len = strlen(file);
+  return len > 3 && strcmp(file + len - 3, ".gz") == 0;
+}
+
+static FILE* snapshot_open(const char *file, bool is_save) {
+  if (!is_gzip(file)) {
+    return fopen(file, is_save ? "wb" : "rb");
+  }
+
+  char cmd[256];
+  if (strchr(file, '\'') != NULL ||
+      snprintf(cmd, sizeof(cmd), (is_save ? "gzip -c > '%s'" : "gzip -dc < '%s'"), file) >= sizeof(cmd)) {
+    return NULL;
+  }
+  return popen(cmd, is_save ? "w" : "r");
+}
+
+static bool snapshot_close(FILE *fp, const char *file) {
+  return (is_gzip(file) ? pclose(fp) : fclose(fp)) == 0;
+}
+
+static bool write_section(FILE *fp, const char *name, const void *data, uint32_t size) {
+  SectionHeader h;
+  memset(&h, 0, sizeof(h));
+  strncpy(h.name, name, SECTION_NAME_LEN - 1);
+  h.size = size;
+  return fwrite(&h, sizeof(h), 1, fp) == 1 &&
+    (size == 0 || fwrite(data, size, 1, fp) == 1);
+}
+
+static inline bool page_is_zero(const uint32_t *p) {
+  int i;
+  for (i = 0; i < PAGE_SIZE / sizeof(uint32_t); i ++) {
+    if (p[i] != 0) { return false; }
+  }
+  return true;
+}
+
+/* Only write the non-zero pages of pmem. Pages never touched
+ * are skipped without reading. */
+static bool write_pmem(FILE *fp) {
+  if (!write_section(fp, "pmem", NULL, 0)) { return false; }
+
+  uint32_t i;
+  for (i = 0; i < pmem_size / PAGE_SIZE; i ++) {
+    void *page = pmem + i * PAGE_SIZE;
+    if (!pmem_touched[i] || page_is_zero(page)) { continue; }
+    if (fwrite(&i, sizeof(i), 1, fp) != 1 || fwrite(page, PAGE_SIZE, 1, fp) != 1) {
+      return false;
+    }
+  }
+  i = PAGE_END;
+  return fwrite(&i, sizeof(i), 1, fp) == 1;
+}
+
+bool snapshot_save(const char *file) {
+  FILE *fp = snapshot_open(file, true);
+  if (fp == NULL) {
+    print_error("Can not open '%s'", file);
+    return false;
+  }
+
+  SnapshotHeader h;
+  memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+  h.version = SNAPSHOT_VERSION;
+  h.pmem_size = pmem_size;
+
+  rtl_eval_eflags();
+  bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+    write_section(fp, "cpu", &cpu, sizeof(cpu)) &&
+    write_section(fp, "clock", &event_now, sizeof(event_now));
+
+  int i;
+  for (i = 0; ok && i < nr_region; i ++) {
+    ok = write_section(fp, regions[i].name, regions[i].addr, regions[i].size);
+  }
+  ok = ok && write_pmem(fp);
+  ok = snapshot_close(fp, file) && ok;
+
+  if (!ok) {
+    print_error("Fail to write snapshot '%s'", file);
+    return false;
+  }
+  Log("Snapshot is saved to %s", file);
+  return true;
+}
+
+static bool read_pmem(FILE *fp) {
+  pmem_reset();
+
+  uint32_t pfn;
+  while (fread(&pfn, sizeof(pfn), 1, fp) == 1) {
+    if (pfn == PAGE_END) { return true; }
+    if (pfn >= pmem_size / PAGE_SIZE || fread(pmem + pfn * PAGE_SIZE, PAGE_SIZE, 1, fp) != 1) {
+      return false;
+    }
+    pmem_touched[pfn] = PMEM_TOUCHED;
+  }
+  return false;
+}
+
+static bool read_section(FILE *fp, const SectionHeader *s) {
+  if (strcmp(s->name, "cpu") == 0) {
+    if (s->size != sizeof(cpu) || fread(&cpu, sizeof(cpu), 1, fp) != 1) { return false; }
+    rtl_set_eflags(&cpu.eflags);
+    return true;
+  }
+  if (strcmp(s->name, "clock") == 0) {
+    uint64_t now;
+    if (s->size != sizeof(now) || fread(&now, sizeof(now), 1, fp) != 1) { return false; }
+    event_reset(now);
+    return true;
+  }
+  if (strcmp(s->name, "pmem") == 0) {
+    return read_pmem(fp);
+  }
+
+  int i;
+  for (i = 0; i < nr_region; i ++) {
+    if (strcmp(s->name, regions[i].name) == 0) {
+      return s->size == regions[i].size && fread(regions[i].addr, s->size, 1, fp) == 1;
+    }
+  }
+  print_error("Unknown section '%s'", s->name);
+  return false;
+}
+
+bool snapshot_load(const char *file) {
+#ifdef DIFF_TEST
+  print_error("Snapshots can not be loaded in differential testing");
+  return false;
+#endif
+
+  FILE *fp = snapshot_open(file, false);
+  if (fp == NULL) {
+    print_error("Can not open '%s'", file);
+    return false;
+  }
+
+  SnapshotHeader h;
+  bool ok = fread(&h, sizeof(h), 1, fp) == 1 &&
+    memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0 &&
+    h.version == SNAPSHOT_VERSION && h.pmem_size <= pmem_size;
+
+  SectionHeader s;
+  while (ok && fread(&s, sizeof(s), 1, fp) == 1) {
+    s.name[SECTION_NAME_LEN - 1] = '\0';
+    ok = read_section(fp, &s);
+  }
+  ok = snapshot_close(fp, file) && ok;
+
+  /* everything derived from the old state is stale */
+  icache_flush();
+  tlb_flush();
+  int i;
+  for (i = 0; i < nr_hook; i ++) {
+    hooks[i]();
+  }
+
+  if (!ok) {
+    print_error("Fail to load snapshot '%s', the machine state may be broken", file);
+    return false;
+  }
+  nemu_state = NEMU_STOP;
+  Log("Snapshot is loaded from %s", file);
+  return true;
+}
@@ -96,6 +96,7 @@ void _asye_init(_RegSet* (*l)(_Event ev, _RegSet *regs));
 _RegSet *_make(_Area kstack, void *entry, void *arg);
 void _trap();
 int _istatus(int enable);
+void _timer_period(uint32_t us);
 
 // =======================================================================
 // [3] Protection Extension (PTE)
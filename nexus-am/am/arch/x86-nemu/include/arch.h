@@ -19,6 +19,8 @@ struct _RegSet {
 #define SYSCALL_ARG2(r) r->ebx
 #define SYSCALL_ARG3(r) r->ecx
 #define SYSCALL_ARG4(r) r->edx
+// go back to the `int $0x80' to do the system call again
+#define SYSCALL_RESTART(r) (r->eip -= 2)
 
 #ifdef __cplusplus
 extern "C" {
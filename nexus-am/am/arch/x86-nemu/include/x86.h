@@ -97,6 +97,12 @@ static inline void set_cr0(uint32_t cr0) {
   asm volatile("movl %0, %%cr0" : : "r"(cr0));
 }
 
+static inline uint32_t get_cr2(void) {
+  volatile uint32_t val;
+  asm volatile("movl %%cr2, %0" : "=r"(val));
+  return val;
+}
+
 
 static inline void set_idt(GateDesc *idt, int size) {
   volatile static uint16_t data[3];
@@ -110,6 +116,16 @@ static inline void set_cr3(void *pdir) {
   asm volatile("movl %0, %%cr3" : : "r"(pdir));
 }
 
+static inline void *get_cr3(void) {
+  volatile uint32_t val;
+  asm volatile("movl %%cr3, %0" : "=r"(val));
+  return (void *)val;
+}
+
+static inline void invlpg(void *va) {
+  asm volatile("invlpg (%0)" : : "r"(va) : "memory");
+}
+
 static inline uint8_t inb(int port) {
   char data;
   asm volatile("inb %1, %0" : "=a"(data) : "d"((uint16_t)port));
@@ -1,12 +1,17 @@
 #include <am.h>
 #include <x86.h>
 
+#define INTR_MASK_PORT 0x21   // Note that this is not standard
+#define TIMER_PORT 0x40       // Note that this is not standard, either
+
 static _RegSet* (*H)(_Event, _RegSet*) = NULL;
 
 void vecsys();
 void vecnull();
 void vectrap();
 void vectimer();
+void veckbd();
+void vecpf();
 
 _RegSet* irq_handle(_RegSet *tf) {
   _RegSet *next = tf;
@@ -16,6 +21,8 @@ _RegSet* irq_handle(_RegSet *tf) {
       case 0x80: ev.event = _EVENT_SYSCALL; break;
       case 0x81: ev.event = _EVENT_TRAP; break;
       case 0x20: ev.event = _EVENT_IRQ_TIME; break;
+      case 0x21: ev.event = _EVENT_IRQ_IODEV; break;
+      case 14: ev.event = _EVENT_PAGE_FAULT; ev.cause = get_cr2(); break;
       default: ev.event = _EVENT_ERROR; break;
     }
 
@@ -42,9 +49,16 @@ void _asye_init(_RegSet*(*h)(_Event, _RegSet*)) {
   idt[0x81] = GATE(STS_TG32, KSEL(SEG_KCODE), vectrap, DPL_KERN);
   // -----------------------  timer ----------------------------
   idt[0x20] = GATE(STS_TG32, KSEL(SEG_KCODE), vectimer, DPL_KERN);
+  // ---------------------- page fault -------------------------
+  idt[14] = GATE(STS_TG32, KSEL(SEG_KCODE), vecpf, DPL_KERN);
+  // ----------------------- keyboard --------------------------
+  idt[0x21] = GATE(STS_TG32, KSEL(SEG_KCODE), veckbd, DPL_KERN);
   
   set_idt(idt, sizeof(idt));
 
+  // unmask the timer (line 0) and the keyboard (line 1)
+  outb(INTR_MASK_PORT, ~0x3);
+
   // register event handler
   H = h;
 }
@@ -60,3 +74,8 @@ void _trap() {
 int _istatus(int enable) {
   return 0;
 }
+
+// set the period of the timer interrupt in microseconds, 0 stops it
+void _timer_period(uint32_t us) {
+  outl(TIMER_PORT, us);
+}
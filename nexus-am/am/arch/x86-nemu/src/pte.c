@@ -58,7 +58,17 @@ void _protect(_Protect *p) {
   p->area.end = (void*)0xc0000000;
 }
 
+// free the page tables of user space and the page directory,
+// but not the pages mapped, which are owned by the caller
 void _release(_Protect *p) {
+  PDE *updir = p->ptr;
+  for (int i = 0; i < NR_PDE; i ++) {
+    if ((updir[i] & PTE_P) && updir[i] != kpdirs[i]) {
+      pfree_f((void *)PTE_ADDR(updir[i]));
+    }
+  }
+  pfree_f(updir);
+  p->ptr = NULL;
 }
 
 void _switch(_Protect *p) {
@@ -78,6 +88,12 @@ void _map(_Protect *p, void *va, void *pa) {
 }
 
 void _unmap(_Protect *p, void *va) {
+  PDE *pde = ((PDE *)p->ptr) + PDX(va);
+  if ((*pde & PTE_P) == 0) return;
+  PTE *ptab = (PTE *)PTE_ADDR(*pde);
+  ptab[PTX(va)] = 0;
+  if (p->ptr == get_cr3())
+    invlpg(va);
 }
 
 _RegSet *_umake(_Protect *p, _Area ustack, _Area kstack, void *entry, char *const argv[], char *const envp[]) {
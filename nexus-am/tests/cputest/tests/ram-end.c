@@ -0,0 +1,17 @@
+#include "trap.h"
+
+int main() {
+	/* the last bytes of RAM, read with every width that fits */
+	volatile unsigned char *end = (void *)_heap.end;
+
+	end[-1] = 0x5a;
+	end[-2] = 0xa5;
+	nemu_assert(end[-1] == 0x5a);
+	nemu_assert(*(volatile unsigned short *)(end - 2) == 0x5aa5);
+
+	*(volatile unsigned *)(end - 4) = 0x12345678;
+	nemu_assert(end[-1] == 0x12);
+	nemu_assert(*(volatile unsigned *)(end - 4) == 0x12345678);
+
+	return 0;
+}
@@ -0,0 +1,26 @@
+#include "trap.h"
+
+char src[16] = "abcdefghijklmno";
+char dst[16];
+
+int main() {
+	int i;
+	for (i = 0; i < 8; i ++) {
+		memset(dst, 0, sizeof(dst));
+
+		/* the widths of the string instructions are not taken from the movl before them */
+		void *s = src, *d = dst;
+		asm volatile("movl $3, %%ecx; rep movsb" : "+S"(s), "+D"(d) : : "ecx", "memory");
+		nemu_assert(memcmp(dst, src, 3) == 0 && dst[3] == 0);
+
+		d = dst + 8;
+		asm volatile("movl $5, %%ecx; rep stosb" : "+D"(d) : "a"('#') : "ecx", "memory");
+		nemu_assert(memcmp(dst + 8, "#####", 5) == 0 && dst[13] == 0);
+
+		s = src; d = dst;
+		asm volatile("movl $2, %%ecx; rep movsw" : "+S"(s), "+D"(d) : : "ecx", "memory");
+		nemu_assert(memcmp(dst, src, 4) == 0 && dst[4] == 0);
+	}
+
+	return 0;
+}
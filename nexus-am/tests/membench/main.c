@@ -0,0 +1,95 @@
+#include <am.h>
+#include <klib.h>
+
+/* A microbenchmark of guest RAM accesses. Every phase is dominated by
+ * loads, stores or instruction fetches, so the time it takes mostly
+ * reflects the cost of a memory access in the emulator.
+ */
+
+#define NR_WORD (256 * 1024)
+#define NR_ROUND 16
+
+static uint32_t buf[NR_WORD];
+
+static uint32_t seq_write(void) {
+  int r, i;
+  for (r = 0; r < NR_ROUND; r ++) {
+    for (i = 0; i < NR_WORD; i ++) {
+      buf[i] = i ^ r;
+    }
+  }
+  return buf[NR_WORD - 1];
+}
+
+static uint32_t seq_read(void) {
+  uint32_t sum = 0;
+  int r, i;
+  for (r = 0; r < NR_ROUND; r ++) {
+    for (i = 0; i < NR_WORD; i ++) {
+      sum += buf[i];
+    }
+  }
+  return sum;
+}
+
+static uint32_t byte_copy(void) {
+  uint8_t *src = (void *)buf, *dst = (void *)&buf[NR_WORD / 2];
+  int r, i;
+  for (r = 0; r < NR_ROUND; r ++) {
+    for (i = 0; i < NR_WORD * 2; i ++) {
+      dst[i] = src[i] + r;
+    }
+  }
+  return buf[NR_WORD - 1];
+}
+
+static uint32_t stride_read(void) {
+  uint32_t sum = 0;
+  int r, i;
+  for (r = 0; r < NR_ROUND * 1024; r ++) {
+    for (i = r & 1023; i < NR_WORD; i += 1024) {
+      sum += buf[i];
+    }
+  }
+  return sum;
+}
+
+static int __attribute__((noinline)) leaf(int x) {
+  return x * 3 + 1;
+}
+
+static uint32_t fetch(void) {
+  uint32_t sum = 0;
+  int i;
+  for (i = 0; i < NR_WORD * NR_ROUND / 4; i ++) {
+    sum += leaf(i);
+  }
+  return sum;
+}
+
+static struct {
+  const char *name;
+  uint32_t (*run)(void);
+} phases[] = {
+  { "seq-write", seq_write },
+  { "seq-read", seq_read },
+  { "byte-copy", byte_copy },
+  { "stride-read", stride_read },
+  { "fetch", fetch },
+};
+
+int main() {
+  _ioe_init();
+
+  unsigned long total = 0;
+  int i;
+  for (i = 0; i < sizeof(phases) / sizeof(phases[0]); i ++) {
+    unsigned long t0 = _uptime();
+    uint32_t ret = phases[i].run();
+    unsigned long ms = _uptime() - t0;
+    total += ms;
+    printf("%s: %d ms (checksum = 0x%x)\n", phases[i].name, (int)ms, ret);
+  }
+  printf("total: %d ms\n", (int)total);
+  return 0;
+}